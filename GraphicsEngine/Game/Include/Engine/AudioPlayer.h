@@ -0,0 +1,60 @@
+﻿#pragma once
+#include "JLib/Vector.h"
+
+struct ma_engine;
+
+namespace game
+{
+	struct AudioMixer;
+
+	struct AudioPlayerCreateInfo final
+	{
+		ma_engine* engine;
+		const char** paths;
+		uint32_t pathCount;
+		// Amount of clips that can be played at the same time. When all voices are busy, the oldest one is stolen.
+		uint32_t voiceCount = 16;
+		// Amount of different clips that can be triggered in a single frame.
+		uint32_t triggerCapacity = 32;
+	};
+
+	struct AudioStats final
+	{
+		float decodeTime = 0;
+		uint32_t memory = 0;
+		uint32_t clipCount = 0;
+		uint32_t voiceCount = 0;
+		uint32_t stolenCount = 0;
+		uint32_t droppedCount = 0;
+
+		void Print() const;
+	};
+
+	// Plays short sound effects from a cache of clips that are decoded once on creation.
+	// Triggers are gathered during the frame and played from a pool of voices on a background thread.
+	class AudioPlayer final
+	{
+	public:
+		// Triggering the same clip more than once in a frame only plays it once, at the highest volume.
+		void Play(uint32_t clip, float volume);
+		// Hands the triggers of this frame over to the audio thread.
+		void Update();
+		[[nodiscard]] AudioStats GetStats() const;
+
+		static AudioPlayer Create(jv::Arena& arena, const AudioPlayerCreateInfo& info);
+		static void Destroy(const AudioPlayer& player);
+
+	private:
+		struct Trigger final
+		{
+			uint32_t clip;
+			float volume;
+		};
+
+		jv::Arena* _arena;
+		uint64_t _scope;
+		uint32_t _clipCount;
+		jv::Vector<Trigger> _triggers;
+		AudioMixer* _mixer;
+	};
+}
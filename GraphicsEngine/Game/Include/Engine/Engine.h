@@ -1,8 +1,14 @@
 ﻿#pragma once
+#include "JobSystem.h"
 #include "TaskSystem.h"
+#include "JLib/ChunkPool.h"
 
 namespace game
 {
+	constexpr uint32_t MAX_TASK_SYSTEM_ACCESS_COUNT = 8;
+
+	struct RenderThreadState;
+
 	struct EngineMemory final
 	{
 		friend class Engine;
@@ -20,6 +26,21 @@ namespace game
 		uint32_t arenaSize = 4096;
 		uint32_t tempArenaSize = 4096;
 		uint32_t frameArenaSize = 4096;
+		// Maximum amount of threads that can claim their own frame arena.
+		uint32_t threadFrameArenaCount = 8;
+		// Amount of frame arena sized chunks shared between the thread frame arenas.
+		uint32_t frameChunkCount = 64;
+		// Amount of threads, besides the main thread, that run task interpreters in parallel.
+		// Capped by the amount of cores and the thread frame arena count.
+		uint32_t jobThreadCount = UINT32_MAX;
+		// Maximum amount of task interpreters, and of task systems that task interpreters push to.
+		uint32_t taskInterpreterCapacity = 32;
+		// Interprets and renders the tasks of a frame on a separate thread, while the next frame is being produced.
+		// Task interpreters and the custom render function then run on the render thread, after it has waited for the swap chain image.
+		// Other graphics engine calls should only be made while the render thread is idle, see WaitForRenderThread.
+		bool renderThread = false;
+		// Tracks arena usage and prints a report on shutdown.
+		bool trackArenaStats = false;
 		glm::ivec2 resolution{ 800, 600 };
 		bool fullScreen = false;
 		const char* name = "window";
@@ -30,15 +51,35 @@ namespace game
 		void (*onScrollCallback)(glm::vec<2, double> offset) = nullptr;
 	};
 
+	// Task interpreters can be updated from any thread, at the same time as interpreters they do not depend on.
+	// During an update, only the frame arena is exclusive to the calling thread.
 	class ITaskInterpreter
 	{
 		friend class Engine;
 
 	protected:
-		[[nodiscard]] void* GetTaskSystemPtr() const;
+		[[nodiscard]] ITaskSystem* GetTaskSystemPtr() const;
+
+		// Declares a task system, besides its own, that this interpreter reads from. Call this in OnStart.
+		template <typename T>
+		void DeclareRead(const TaskSystem<T>& taskSystem);
+		// Declares a task system that this interpreter pushes tasks to. Call this in OnStart.
+		template <typename T>
+		void DeclareWrite(TaskSystem<T>& taskSystem);
+		// Interpreters that record draw calls record them into their own draw batch, so they can be updated in parallel.
+		// The batches are executed in the order the interpreters were added.
+		void DeclareGraphicsAccess();
 
 	private:
-		void* _taskSystem;
+		ITaskSystem* _taskSystem;
+		const ITaskSystem* _reads[MAX_TASK_SYSTEM_ACCESS_COUNT]{};
+		ITaskSystem* _writes[MAX_TASK_SYSTEM_ACCESS_COUNT]{};
+		uint32_t _readCount = 0;
+		uint32_t _writeCount = 0;
+		bool _graphicsAccess = false;
+
+		[[nodiscard]] bool Reads(const ITaskSystem* taskSystem) const;
+		[[nodiscard]] bool Writes(const ITaskSystem* taskSystem) const;
 		
 		virtual void Update(const EngineMemory& memory) = 0;
 		virtual void Exit(const EngineMemory& memory) = 0;
@@ -66,28 +107,87 @@ namespace game
 		template <typename Task, typename Interpreter, typename CreateInfo>
 		[[nodiscard]] Interpreter& AddTaskInterpreter(TaskSystem<Task>& taskSystem, const CreateInfo& createInfo);
 		[[nodiscard]] bool Update(bool(*customRenderFunc)(void* userPtr) = nullptr, void* userPtr = nullptr);
+		// Blocks until the render thread has finished the frame it is working on. Does nothing without a render thread.
+		void WaitForRenderThread() const;
 
 		[[nodiscard]] static Engine Create(const EngineCreateInfo& info);
 		static void Destroy(const Engine& engine);
 		[[nodiscard]] EngineMemory GetMemory();
 		[[nodiscard]] jv::Arena CreateSubArena(uint32_t size);
+		// Returns a frame arena that is exclusive to the calling thread.
+		// Like the main frame arena, it is reset at the end of every update.
+		[[nodiscard]] jv::Arena& GetThreadFrameArena();
+		// Returns a temp arena that is exclusive to the calling thread.
+		// Job threads use their thread frame arena, so allocations have to be made in a scope.
+		[[nodiscard]] jv::Arena& GetThreadTempArena();
 		[[nodiscard]] static glm::ivec2 GetResolution();
 
 	private:
+		struct JobInfo final
+		{
+			Engine* engine;
+			ITaskInterpreter* interpreter;
+			ITaskSystem* taskSystem;
+			uint32_t stagingIndex;
+			uint32_t drawOrder;
+		};
+
 		void* _arenaMem;
 		void* _tempArenaMem;
 		void* _frameArenaMem;
+		void* _renderFrameArenaMem = nullptr;
+		void* _renderTempArenaMem = nullptr;
 		jv::Arena _arena;
 		jv::Arena _tempArena;
 		jv::Arena _frameArena;
+		// Frame arena of the frame that is being rendered. Swapped with the frame arena when a frame starts rendering.
+		jv::Arena _renderFrameArena;
+		// Arenas of the render thread itself, so that it never allocates from the arenas the game thread is using.
+		jv::Arena _renderTempArena;
+		jv::Arena _renderThreadFrameArena;
+		RenderThreadState* _renderThread = nullptr;
+		jv::Arena* _threadFrameArenas;
+		uint32_t _threadFrameArenaCount;
+		std::atomic<uint32_t>* _claimedThreadFrameArenas;
 		jv::LinkedList<ITaskSystem*> _taskSystems{};
 		jv::LinkedList<ITaskInterpreter*> _taskInterpreters{};
+		JobSystem _jobSystem;
+		// Sized for the largest possible graph, so that rebuilding it doesn't allocate.
+		Job* _interpreterJobs = nullptr;
+		JobInfo* _interpreterJobInfos = nullptr;
+		// One row of dependents per job.
+		uint32_t* _interpreterJobDependents = nullptr;
+		uint32_t _interpreterJobCount = 0;
+		uint32_t _interpreterCount = 0;
+		uint32_t _taskInterpreterCapacity;
+
+		[[nodiscard]] bool UpdateWithRenderThread(bool(*customRenderFunc)(void* userPtr), void* userPtr);
+		[[nodiscard]] bool Render(bool(*customRenderFunc)(void* userPtr), void* userPtr);
+		void BuildInterpreterGraph();
+		[[nodiscard]] uint32_t GetDrawBatchThreadIndex() const;
+		static void RunRenderThread(Engine* engine);
+		static void UpdateInterpreter(void* userPtr);
+		static void MergeStagedTasks(void* userPtr);
 	};
 
+	template <typename T>
+	void ITaskInterpreter::DeclareRead(const TaskSystem<T>& taskSystem)
+	{
+		assert(_readCount < MAX_TASK_SYSTEM_ACCESS_COUNT);
+		_reads[_readCount++] = &taskSystem;
+	}
+
+	template <typename T>
+	void ITaskInterpreter::DeclareWrite(TaskSystem<T>& taskSystem)
+	{
+		assert(_writeCount < MAX_TASK_SYSTEM_ACCESS_COUNT);
+		_writes[_writeCount++] = &taskSystem;
+	}
+
 	template <typename Task, typename CreateInfo>
 	void TaskInterpreter<Task, CreateInfo>::Update(const EngineMemory& memory)
 	{
-		auto taskSystem = static_cast<TaskSystem<Task>*>(GetTaskSystemPtr());
+		const auto taskSystem = static_cast<TaskSystem<Task>*>(GetTaskSystemPtr());
 		auto batches = taskSystem->GetTaskBatches();
 		OnUpdate(memory, batches);
 	}
@@ -102,7 +202,8 @@ namespace game
 	TaskSystem<T>& Engine::AddTaskSystem()
 	{
 		auto sys = _arena.New<TaskSystem<T>>();
-		*sys = TaskSystem<T>::Create(_frameArena);
+		// Staging slot 0 is used outside of task interpreter updates.
+		*sys = TaskSystem<T>::Create(_arena, _frameArena, _taskInterpreterCapacity + 1, _renderThread != nullptr);
 		Add(_arena, _taskSystems) = sys;
 		return *sys;
 	}
@@ -0,0 +1,41 @@
+﻿#pragma once
+
+namespace game
+{
+	struct JobSystemState;
+
+	struct JobSystemCreateInfo final
+	{
+		// Amount of worker threads. The thread that calls Run also executes jobs.
+		uint32_t threadCount = 0;
+		// Maximum amount of jobs per run.
+		uint32_t capacity = 64;
+	};
+
+	struct Job final
+	{
+		void (*func)(void* userPtr) = nullptr;
+		void* userPtr = nullptr;
+		// Indices of the jobs that can only start after this one is done.
+		uint32_t* dependents = nullptr;
+		uint32_t dependentCount = 0;
+		// Amount of jobs that have to be done before this one can start.
+		uint32_t dependencyCount = 0;
+	};
+
+	// Runs a graph of jobs over a fixed set of threads. Every thread has its own deque of jobs that are ready to run.
+	// Threads pop from their own deque first and steal from the others when it is empty.
+	class JobSystem final
+	{
+	public:
+		// Runs all jobs while respecting their dependencies. Returns when every job is done.
+		void Run(const Job* jobs, uint32_t count) const;
+		[[nodiscard]] uint32_t GetThreadCount() const;
+
+		[[nodiscard]] static JobSystem Create(jv::Arena& arena, const JobSystemCreateInfo& info);
+		static void Destroy(const JobSystem& jobSystem);
+
+	private:
+		JobSystemState* _state = nullptr;
+	};
+}
@@ -1,4 +1,4 @@
-#pragma once
+﻿#pragma once
 #include "JLib/VectorUtils.h"
 #include "JLib/LinkedListUtils.h"
 
@@ -6,13 +6,32 @@ namespace game
 {
 	class ITaskSystem
 	{
+		friend class Engine;
+
 	public:
 		bool autoClear = true;
 		virtual void ClearTasks() = 0;
+
+	protected:
+		// Returns the frame arena of the task interpreter that is being updated on the calling thread, if any.
+		[[nodiscard]] static jv::Arena& GetThreadFrameArena(jv::Arena& fallback);
+		// Returns the staging slot of the task interpreter that is being updated on the calling thread.
+		// Slot 0 is used outside of task interpreter updates.
+		[[nodiscard]] static uint32_t GetStagingIndex();
+
+	private:
+		// Appends the tasks that were pushed from task interpreters, in staging slot order.
+		virtual void MergeStagedTasks() = 0;
+		// Hands the pushed tasks over to the task interpreters and starts a new frame. Only used with a render thread.
+		// Tasks that are copied over are allocated from the given frame arena.
+		virtual void SwapBuffers(jv::Arena& frameArena) = 0;
 	};
 
+	// Tasks can be pushed from multiple task interpreters at the same time.
+	// Every interpreter pushes into its own staging slot, which the engine merges before the tasks are read.
+	// When the engine uses a render thread, tasks are pushed to one buffer while the interpreters read from the other.
 	template <typename T>
-	class TaskSystem final : ITaskSystem
+	class TaskSystem final : public ITaskSystem
 	{
 		friend class Engine;
 
@@ -20,17 +39,44 @@ namespace game
 		void Allocate(jv::Arena& arena, uint32_t chunkSize);
 
 		void Push(const T& task);
+		// Returns the tasks that are being interpreted.
 		[[nodiscard]] jv::LinkedList<jv::Vector<T>> GetTaskBatches();
+		// Clears the tasks that are being pushed to.
 		void ClearTasks() override;
 
 	private:
+		struct alignas(jv::CACHE_LINE_SIZE) Staging final
+		{
+			jv::LinkedListNode<jv::Vector<T>>* first = nullptr;
+			jv::LinkedListNode<jv::Vector<T>>* last = nullptr;
+		};
+
+		struct Buffer final
+		{
+			jv::LinkedListNode<jv::Vector<T>> tasks{};
+			// Batch that is currently being filled.
+			jv::LinkedListNode<jv::Vector<T>>* last = nullptr;
+		};
+
 		uint32_t _chunkSize = 0;
 		jv::Arena* _frameArena;
 
-		jv::LinkedListNode<jv::Vector<T>> _tasks{};
-		jv::LinkedList<jv::Vector<T>> _additionalTasks{};
-
-		[[nodiscard]] static TaskSystem Create(jv::Arena& frameArena);
+		Buffer _buffers[2]{};
+		uint32_t _bufferCount = 1;
+		// Buffer that is pushed to from outside of task interpreter updates.
+		uint32_t _pushIndex = 0;
+		// Buffer that the task interpreters read from and push to.
+		uint32_t _interpretIndex = 0;
+		Staging* _staging = nullptr;
+		uint32_t _stagingCount = 0;
+
+		void PushDirect(Buffer& buffer, const T& task, jv::Arena& frameArena);
+		void ClearBuffer(Buffer& buffer);
+		[[nodiscard]] jv::LinkedListNode<jv::Vector<T>>* CreateBatch(jv::Arena& frameArena) const;
+		void MergeStagedTasks() override;
+		void SwapBuffers(jv::Arena& frameArena) override;
+
+		[[nodiscard]] static TaskSystem Create(jv::Arena& arena, jv::Arena& frameArena, uint32_t stagingCount, bool doubleBuffered);
 		static void Destroy(jv::Arena& arena, const TaskSystem& taskSystem);
 	};
 
@@ -38,62 +84,142 @@ namespace game
 	void TaskSystem<T>::Allocate(jv::Arena& arena, const uint32_t chunkSize)
 	{
 		_chunkSize = chunkSize;
-		_tasks.value = jv::CreateVector<T>(arena, chunkSize);
-		_additionalTasks = {};
+		for (uint32_t i = 0; i < _bufferCount; ++i)
+		{
+			auto& buffer = _buffers[i];
+			buffer.tasks.value = jv::CreateVector<T>(arena, chunkSize);
+			buffer.tasks.next = nullptr;
+			buffer.last = &buffer.tasks;
+		}
 	}
 
 	template <typename T>
 	void TaskSystem<T>::Push(const T& task)
 	{
 		assert(_chunkSize > 0);
-		const auto batches = GetTaskBatches();
 
-		bool fit = false;
-		for (auto& batch : batches)
+		const uint32_t stagingIndex = GetStagingIndex();
+		if (stagingIndex == 0)
 		{
-			if (batch.count == batch.length)
-				continue;
-
-			batch.Add() = task;
-			fit = true;
-		}
-
-		if (fit)
-			return;
-		if (_chunkSize == 0)
+			PushDirect(_buffers[_pushIndex], task, GetThreadFrameArena(*_frameArena));
 			return;
+		}
 
-		auto& vector = Add(*_frameArena, _additionalTasks) = jv::CreateVector<T>(*_frameArena, _chunkSize);
-		vector.Add() = task;
+		assert(stagingIndex < _stagingCount);
+		auto& staging = _staging[stagingIndex];
+		if (!staging.last || staging.last->value.count == staging.last->value.length)
+		{
+			const auto batch = CreateBatch(GetThreadFrameArena(*_frameArena));
+			if (staging.last)
+				staging.last->next = batch;
+			else
+				staging.first = batch;
+			staging.last = batch;
+		}
+		staging.last->value.Add() = task;
 	}
 
 	template <typename T>
 	jv::LinkedList<jv::Vector<T>> TaskSystem<T>::GetTaskBatches()
 	{
 		jv::LinkedList<jv::Vector<T>> taskBatches{};
-		_tasks.next = _additionalTasks.values;
-		taskBatches.values = &_tasks;
+		taskBatches.values = &_buffers[_interpretIndex].tasks;
 		return taskBatches;
 	}
 
 	template <typename T>
 	void TaskSystem<T>::ClearTasks()
 	{
-		_tasks.value.Clear();
-		_additionalTasks = {};
+		ClearBuffer(_buffers[_pushIndex]);
+		if (_pushIndex != _interpretIndex)
+			return;
+		for (uint32_t i = 0; i < _stagingCount; ++i)
+			_staging[i] = {};
+	}
+
+	template <typename T>
+	void TaskSystem<T>::PushDirect(Buffer& buffer, const T& task, jv::Arena& frameArena)
+	{
+		if (buffer.last->value.count == buffer.last->value.length)
+		{
+			const auto batch = CreateBatch(frameArena);
+			buffer.last->next = batch;
+			buffer.last = batch;
+		}
+		buffer.last->value.Add() = task;
+	}
+
+	template <typename T>
+	void TaskSystem<T>::ClearBuffer(Buffer& buffer)
+	{
+		buffer.tasks.value.Clear();
+		buffer.tasks.next = nullptr;
+		buffer.last = &buffer.tasks;
+	}
+
+	template <typename T>
+	jv::LinkedListNode<jv::Vector<T>>* TaskSystem<T>::CreateBatch(jv::Arena& frameArena) const
+	{
+		const auto batch = frameArena.New<jv::LinkedListNode<jv::Vector<T>>>();
+		batch->value = jv::CreateVector<T>(frameArena, _chunkSize);
+		return batch;
+	}
+
+	template <typename T>
+	void TaskSystem<T>::MergeStagedTasks()
+	{
+		auto& buffer = _buffers[_interpretIndex];
+		auto& frameArena = GetThreadFrameArena(*_frameArena);
+		for (uint32_t i = 1; i < _stagingCount; ++i)
+		{
+			auto& staging = _staging[i];
+			for (auto batch = staging.first; batch; batch = batch->next)
+				for (const auto& task : batch->value)
+					PushDirect(buffer, task, frameArena);
+			staging = {};
+		}
+	}
+
+	template <typename T>
+	void TaskSystem<T>::SwapBuffers(jv::Arena& frameArena)
+	{
+		assert(_bufferCount == 2);
+		for (uint32_t i = 0; i < _stagingCount; ++i)
+			_staging[i] = {};
+
+		if (autoClear)
+		{
+			const uint32_t pushIndex = _pushIndex;
+			_pushIndex = _interpretIndex;
+			_interpretIndex = pushIndex;
+			ClearBuffer(_buffers[_pushIndex]);
+			return;
+		}
+
+		// The pushed tasks persist, so the interpreters get a copy of them.
+		auto& buffer = _buffers[_interpretIndex];
+		ClearBuffer(buffer);
+		for (auto batch = &_buffers[_pushIndex].tasks; batch; batch = batch->next)
+			for (const auto& task : batch->value)
+				PushDirect(buffer, task, frameArena);
 	}
 
 	template <typename T>
-	TaskSystem<T> TaskSystem<T>::Create(jv::Arena& frameArena)
+	TaskSystem<T> TaskSystem<T>::Create(jv::Arena& arena, jv::Arena& frameArena, const uint32_t stagingCount, const bool doubleBuffered)
 	{
 		TaskSystem<T> taskSystem{};
 		taskSystem._frameArena = &frameArena;
+		taskSystem._staging = arena.New<Staging>(stagingCount);
+		taskSystem._stagingCount = stagingCount;
+		taskSystem._bufferCount = doubleBuffered ? 2 : 1;
+		taskSystem._interpretIndex = doubleBuffered ? 1 : 0;
 		return taskSystem;
 	}
 
 	template <typename T>
 	void TaskSystem<T>::Destroy(jv::Arena& arena, const TaskSystem& taskSystem)
 	{
-		jv::DestroyVector(arena, taskSystem._tasks.value);
+		for (uint32_t i = taskSystem._bufferCount; i > 0; --i)
+			jv::DestroyVector(arena, taskSystem._buffers[i - 1].tasks.value);
 	}
 }
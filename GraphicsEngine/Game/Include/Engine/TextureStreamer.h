@@ -1,20 +1,33 @@
 ﻿#pragma once
 #include "GE/AtlasGenerator.h"
 #include "GE/GraphicsEngine.h"
+#include "JLib/HashMap.h"
 #include "JLib/LinkedList.h"
 #include "JLib/Vector.h"
 
 namespace game
 {
+	struct TextureDecoder;
+
+	// Streams textures in and out of a pool of images.
+	// Textures are decoded on background threads and uploaded in Update, so requesting one never blocks the frame.
 	class TextureStreamer final
 	{
 	public:
+		// Called from Update when a texture has been uploaded and can be drawn.
+		void (*onTextureReady)(uint32_t i, void* userPtr) = nullptr;
+		void* userPtr = nullptr;
+
+		// Returns nullptr, so that the renderer uses its fallback image, until the texture has been uploaded.
 		[[nodiscard]] jv::ge::Resource Get(uint32_t i, uint32_t* outFrameCount);
+		[[nodiscard]] bool IsReady(uint32_t i) const;
 		uint32_t DefineTexturePath(const char* path);
-		void Update() const;
+		// Uploads decoded textures and frees the images that have not been used for a while.
+		void Update();
 
 		static TextureStreamer Create(jv::Arena& arena, uint32_t poolChunkSize, uint32_t idCount, 
-			const jv::ge::ImageCreateInfo& imageCreateInfo, uint32_t frameWidth);
+			const jv::ge::ImageCreateInfo& imageCreateInfo, uint32_t frameWidth, 
+			uint32_t decodeThreadCount = 1, uint32_t uploadsPerFrame = 4);
 		static void Destroy(const TextureStreamer& pool);
 
 	private:
@@ -26,6 +39,13 @@ namespace game
 
 		struct Id final
 		{
+			enum class State
+			{
+				unloaded,
+				loading,
+				ready
+			} state = State::unloaded;
+
 			Resource* resource = nullptr;
 			const char* path = nullptr;
 			uint32_t inactiveCount = 0;
@@ -37,8 +57,13 @@ namespace game
 		uint32_t _poolChunkSize;
 		uint32_t _idCount = 0;
 		uint32_t _frameWidth;
+		uint32_t _uploadsPerFrame;
 		jv::ge::ImageCreateInfo _imageCreateInfo{};
 		jv::LinkedList<jv::Vector<Resource>> _pools{};
 		jv::Array<Id> _ids;
+		jv::HashMap<const char*, uint32_t> _pathIds;
+		TextureDecoder* _decoder;
+
+		[[nodiscard]] Resource* ClaimResource();
 	};
 }
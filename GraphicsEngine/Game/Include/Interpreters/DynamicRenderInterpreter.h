@@ -9,7 +9,6 @@ namespace game
 	struct DynamicRenderInterpreterCreateInfo final
 	{
 		glm::ivec2 resolution;
-		jv::Arena* frameArena;
 		TaskSystem<LightTask>* lightTasks;
 
 		const char* fragPath = "Shaders/frag-dyn.spv";
@@ -41,9 +41,10 @@ namespace game
 			_capacity = info.capacity;
 
 			jv::ge::BufferCreateInfo bufferCreateInfo{};
-			bufferCreateInfo.size = info.capacity * jv::ge::GetFrameCount() * static_cast<uint32_t>(sizeof(Task));
+			bufferCreateInfo.size = info.capacity * static_cast<uint32_t>(sizeof(Task));
 			bufferCreateInfo.scene = info.scene;
 			bufferCreateInfo.type = jv::ge::BufferCreateInfo::Type::storage;
+			bufferCreateInfo.dynamic = true;
 			_buffer = AddBuffer(bufferCreateInfo);
 
 			int texWidth, texHeight, texChannels2;
@@ -91,7 +92,7 @@ namespace game
 				jv::ge::WriteInfo::Binding writeBindingInfo{};
 				writeBindingInfo.type = jv::ge::BindingType::storageBuffer;
 				writeBindingInfo.buffer.buffer = _buffer;
-				writeBindingInfo.buffer.offset = sizeof(Task) * info.capacity * i;
+				writeBindingInfo.buffer.offset = jv::ge::GetBufferSlice(_buffer, i).offset;
 				writeBindingInfo.buffer.range = sizeof(Task) * info.capacity;
 				writeBindingInfo.index = 0;
 
@@ -127,6 +128,7 @@ namespace game
 		void OnStart(const InstancedRenderInterpreterCreateInfo& createInfo, const EngineMemory& memory) override
 		{
 			_createInfo = createInfo;
+			this->DeclareGraphicsAccess();
 
 			const auto tempScope = memory.tempArena.CreateScope();
 			const auto vertCode = jv::file::Load(memory.tempArena, createInfo.vertPath);
@@ -177,12 +179,10 @@ namespace game
 
 			const uint32_t frameIndex = jv::ge::GetFrameIndex();
 
-			jv::ge::BufferUpdateInfo bufferUpdateInfo{};
-			bufferUpdateInfo.buffer = _buffer;
-			bufferUpdateInfo.size = sizeof(Task) * _capacity;
-			bufferUpdateInfo.offset = sizeof(Task) * _capacity * frameIndex;
-			bufferUpdateInfo.data = renderedTasks.ptr;
-			UpdateBuffer(bufferUpdateInfo);
+			assert(renderedTasks.count <= _capacity);
+			const auto slice = jv::ge::GetBufferSlice(_buffer, frameIndex);
+			memcpy(slice.data, renderedTasks.ptr, sizeof(Task) * renderedTasks.count);
+			jv::ge::FlushBufferSlice(_buffer, slice);
 
 			jv::ge::WriteInfo::Binding writeBindingInfo{};
 			writeBindingInfo.type = jv::ge::BindingType::sampler;
@@ -25,6 +25,7 @@ namespace game
 		const EngineMemory& memory)
 	{
 		_tasks = createInfo.tasks;
+		this->DeclareWrite(*createInfo.tasks);
 	}
 
 	template <typename T>
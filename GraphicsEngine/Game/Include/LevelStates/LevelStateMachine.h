@@ -20,9 +20,14 @@ namespace game
 		uint32_t next = -1;
 		LevelState<T>** states;
 		uint32_t length;
+		uint32_t createdCount = 0;
 
 		bool Update(const LevelUpdateInfo& info, Level* level, LevelIndex& loadLevelIndex);
+		// Creates the next state. Returns true once all states have been created.
+		bool CreateNext(const LevelCreateInfo& info);
 		static LevelStateMachine Create(const LevelCreateInfo& info, const jv::Array<LevelState<T>*>& states, const T& state = {});
+		// Creates the state machine without creating its states, which can then be created one by one with CreateNext.
+		static LevelStateMachine CreateDeferred(const jv::Array<LevelState<T>*>& states, const T& state = {});
 	};
 
 	template <typename T>
@@ -47,17 +52,34 @@ namespace game
 		return res;
 	}
 
+	template <typename T>
+	bool LevelStateMachine<T>::CreateNext(const LevelCreateInfo& info)
+	{
+		if (createdCount == length)
+			return true;
+
+		states[createdCount]->Create(state, info);
+		if (++createdCount < length)
+			return false;
+		states[0]->Reset(state, info);
+		return true;
+	}
+
 	template <typename T>
 	LevelStateMachine<T> LevelStateMachine<T>::Create(const LevelCreateInfo& info, const jv::Array<LevelState<T>*>& states, const T& state)
+	{
+		auto stateMachine = CreateDeferred(states, state);
+		while (!stateMachine.CreateNext(info));
+		return stateMachine;
+	}
+
+	template <typename T>
+	LevelStateMachine<T> LevelStateMachine<T>::CreateDeferred(const jv::Array<LevelState<T>*>& states, const T& state)
 	{
 		LevelStateMachine<T> stateMachine{};
 		stateMachine.state = state;
 		stateMachine.states = states.ptr;
 		stateMachine.length = states.length;
-		
-		for (auto& levelState : states)
-			levelState->Create(stateMachine.state, info);
-		states[0]->Reset(stateMachine.state, info);
 		return stateMachine;
 	}
 }
@@ -202,6 +202,8 @@ namespace game
 		bool canPause;
 
 		virtual void Create(const LevelCreateInfo& info);
+		// Continues creating the level after Create. Returns true once the level is fully created.
+		virtual bool CreateNext(const LevelCreateInfo& info);
 		virtual bool Update(const LevelUpdateInfo& info, LevelIndex& loadLevelIndex);
 		virtual void PostUpdate(const LevelUpdateInfo& info);
 
@@ -145,6 +145,7 @@ namespace game
 		LevelStateMachine<State> stateMachine;
 		
 		void Create(const LevelCreateInfo& info) override;
+		bool CreateNext(const LevelCreateInfo& info) override;
 		bool Update(const LevelUpdateInfo& info, LevelIndex& loadLevelIndex) override;
 	};
 }
@@ -41,7 +41,9 @@ namespace game
 		jv::Vector<uint32_t> magicDeck;
 		jv::Vector<uint32_t> hand;
 		BoardState boardState;
+		// Grows on demand up to STACK_MAX_SIZE, at which point the stack overloads.
 		jv::Vector<ActionState> stack;
+		jv::Arena* arena;
 
 		uint32_t mana;
 		uint32_t maxMana;
@@ -2,7 +2,8 @@
 
 namespace game
 {
-	struct LightTask final
+	// Copied directly into the light buffer, so keep it vec4 aligned.
+	struct alignas(16) LightTask final
 	{
 		glm::vec4 color{1};
 		glm::vec4 pos{0.f, 0.f, 1.f, 0};
@@ -3,7 +3,8 @@
 
 namespace game
 {
-	struct RenderTask final
+	// Aligned to 16 bytes since it is uploaded to the GPU as is.
+	struct alignas(16) RenderTask final
 	{
 		glm::vec2 position{};
 		glm::vec2 scale{ 1 };
@@ -1,10 +1,11 @@
-#include "pch_game.h"
+﻿#include "pch_game.h"
 #include "CardGame.h"
 
 #include <chrono>
 #include <fstream>
 #include <stb_image.h>
 #include <Engine/Engine.h>
+#include "Engine/AudioPlayer.h"
 #include "Cards/ArtifactCard.h"
 #include "Cards/SpellCard.h"
 #include "Cards/MonsterCard.h"
@@ -36,6 +37,19 @@ namespace game
 	constexpr const char* ATLAS_META_DATA_PATH = "Art/AtlasMetaData.txt";
 	constexpr const char* SAVE_DATA_PATH = "SaveData.txt";
 	constexpr const char* RESOLUTION_DATA_PATH = "Resolution.txt";
+	// Time per frame that can be spent on loading a level.
+	constexpr float LEVEL_LOADING_BUDGET = 4;
+	constexpr uint32_t AUDIO_ATTACK_COUNT = 9;
+	constexpr uint32_t AUDIO_DAMAGED_COUNT = 6;
+
+	enum AudioClipId
+	{
+		AUDIO_CLICK,
+		AUDIO_HOVER,
+		AUDIO_ATTACK,
+		AUDIO_DAMAGED = AUDIO_ATTACK + AUDIO_ATTACK_COUNT,
+		AUDIO_CLIP_COUNT = AUDIO_DAMAGED + AUDIO_DAMAGED_COUNT
+	};
 
 	struct KeyCallback final
 	{
@@ -53,6 +67,14 @@ namespace game
 			jv::ge::Resource sampler;
 		};
 
+		enum class LevelLoadingStage
+		{
+			waitForFrames,
+			clearScene,
+			create,
+			createNext
+		};
+
 		struct SwapChainPushConstant
 		{
 			glm::ivec2 resolution;
@@ -111,6 +133,7 @@ namespace game
 
 		LevelIndex levelIndex = LevelIndex::mainMenu;
 		bool levelLoading = true;
+		LevelLoadingStage levelLoadingStage = LevelLoadingStage::waitForFrames;
 		uint32_t levelLoadingFrame = 0;
 
 		jv::Array<Level*> levels{};
@@ -143,12 +166,11 @@ namespace game
 		ma_sound backgroundAudio;
 		bool musicEnabled;
 
-		ma_sound clickAudio;
-		ma_sound hoverAudio;
-		ma_sound attackAudios[9];
-		ma_sound damagedAudios[6];
+		AudioPlayer audioPlayer;
 
 		[[nodiscard]] bool Update();
+		// Continues loading the current level within the frame budget. Returns true once the level is loaded.
+		[[nodiscard]] bool UpdateLevelLoading();
 		static void Create(CardGame* outCardGame);
 		static void Destroy(CardGame& cardGame);
 
@@ -207,36 +229,12 @@ namespace game
 	{
 		UpdateInput();
 		textureStreamer.Update();
+		largeTextureStreamer.Update();
+		// Start the streamed uploads now, so that they run while the rest of the frame is being built.
+		jv::ge::FlushUploads();
 
-		if(levelLoading)
-		{
-			if (++levelLoadingFrame < jv::ge::GetFrameCount())
-				return true;
-			levelLoadingFrame = 0;
-
-			jv::ge::ClearScene(levelScene);
-			levelArena.Clear();
-			const LevelCreateInfo info
-			{
-				levelArena,
-				engine.GetMemory().tempArena,
-				engine.GetMemory().frameArena,
-				levelScene,
-				atlasTextures,
-				gameState,
-				monsters,
-				artifacts,
-				bosses,
-				rooms,
-				spells,
-				curses,
-				events,
-				musicEnabled
-			};
-			
-			levels[static_cast<uint32_t>(levelIndex)]->Create(info);
-			levelLoading = false;
-		}
+		if (levelLoading)
+			levelLoading = !UpdateLevelLoading();
 
 		const auto currentTime = timer.now();
 		const auto deltaTime = std::chrono::duration_cast<std::chrono::milliseconds>(currentTime - prevTime).count();
@@ -313,43 +311,30 @@ namespace game
 
 		prevTime = currentTime;
 		auto loadLevelIndex = levelIndex;
-		const auto level = levels[static_cast<uint32_t>(levelIndex)];
-		auto result = level->Update(info, loadLevelIndex);
-		if (!result)
-			return result;
-		level->PostUpdate(info);
+		auto result = true;
+
+		// Keep rendering while the level is loading, but don't update it until it's fully created.
+		if(!levelLoading)
+		{
+			const auto level = levels[static_cast<uint32_t>(levelIndex)];
+			result = level->Update(info, loadLevelIndex);
+			if (!result)
+				return result;
+			level->PostUpdate(info);
+		}
 
 		if (info.inputState.enter.PressEvent())
 			playClick = true;
 
 		if (playClick)
-		{
-			ma_sound_set_volume(&clickAudio, .1);
-			ma_sound_seek_to_pcm_frame(&clickAudio, 0);
-			ma_sound_start(&clickAudio);
-		}
+			audioPlayer.Play(AUDIO_CLICK, .1);
 		if (playHover)
-		{
-			ma_sound_set_volume(&hoverAudio, .05);
-			ma_sound_seek_to_pcm_frame(&hoverAudio, 0);
-			ma_sound_start(&hoverAudio);
-		}
+			audioPlayer.Play(AUDIO_HOVER, .05);
 		if (playAttack)
-		{
-			uint32_t randInt = rand() % 9;
-			const auto ptr = &attackAudios[randInt];
-			ma_sound_set_volume(ptr, .2);
-			ma_sound_seek_to_pcm_frame(ptr, 0);
-			ma_sound_start(ptr);
-		}
+			audioPlayer.Play(AUDIO_ATTACK + rand() % AUDIO_ATTACK_COUNT, .2);
 		if (playDamaged)
-		{
-			uint32_t randInt = rand() % 6;
-			const auto ptr = &damagedAudios[randInt];
-			ma_sound_set_volume(ptr, .5);
-			ma_sound_seek_to_pcm_frame(ptr, 0);
-			ma_sound_start(ptr);
-		}
+			audioPlayer.Play(AUDIO_DAMAGED + rand() % AUDIO_DAMAGED_COUNT, .5);
+		audioPlayer.Update();
 
 		if (musicEnabled != musicEnabledCurrent)
 		{
@@ -378,6 +363,7 @@ namespace game
 		{
 			levelIndex = loadLevelIndex;
 			levelLoading = true;
+			levelLoadingStage = LevelLoadingStage::waitForFrames;
 		}
 
 		result = engine.Update([](void* userPtr)
@@ -434,6 +420,65 @@ namespace game
 		return result;
 	}
 
+	bool CardGame::UpdateLevelLoading()
+	{
+		// Wait until the frames in flight no longer use the previous level's resources.
+		if(levelLoadingStage == LevelLoadingStage::waitForFrames)
+		{
+			if (++levelLoadingFrame < jv::ge::GetFrameCount())
+				return false;
+			levelLoadingFrame = 0;
+			levelLoadingStage = LevelLoadingStage::clearScene;
+		}
+
+		const LevelCreateInfo info
+		{
+			levelArena,
+			engine.GetMemory().tempArena,
+			engine.GetMemory().frameArena,
+			levelScene,
+			atlasTextures,
+			gameState,
+			monsters,
+			artifacts,
+			bosses,
+			rooms,
+			spells,
+			curses,
+			events,
+			musicEnabled
+		};
+
+		const auto level = levels[static_cast<uint32_t>(levelIndex)];
+		const auto startTime = timer.now();
+
+		// Always make progress, even when a single step exceeds the budget.
+		do
+		{
+			switch (levelLoadingStage)
+			{
+			case LevelLoadingStage::clearScene:
+				// The next level allocates about as much as this one, so keep the device memory around.
+				jv::ge::ClearScene(levelScene, true);
+				levelArena.Clear();
+				levelLoadingStage = LevelLoadingStage::create;
+				break;
+			case LevelLoadingStage::create:
+				level->Create(info);
+				levelLoadingStage = LevelLoadingStage::createNext;
+				break;
+			case LevelLoadingStage::createNext:
+				if (!level->CreateNext(info))
+					break;
+				levelLoadingStage = LevelLoadingStage::waitForFrames;
+				return true;
+			default:
+				break;
+			}
+		} while (std::chrono::duration<float, std::milli>(timer.now() - startTime).count() < LEVEL_LOADING_BUDGET);
+		return false;
+	}
+
 	void CardGame::Create(CardGame* outCardGame)
 	{
 		srand(time(nullptr));
@@ -454,6 +499,9 @@ namespace game
 			engineCreateInfo.fullScreen = fullScreen;
 			engineCreateInfo.name = "DARK CRESCENT";
 			engineCreateInfo.icon = "Art/icon.png";
+#ifdef _DEBUG
+			engineCreateInfo.trackArenaStats = true;
+#endif
 			outCardGame->engine = Engine::Create(engineCreateInfo);
 		}
 		outCardGame->restart = false;
@@ -486,48 +534,43 @@ namespace game
 		ma_sound_start(&outCardGame->backgroundAudio);
 		ma_sound_set_volume(&outCardGame->backgroundAudio, AUDIO_BACKGROUND_VOLUME);
 
-		result = ma_sound_init_from_file(&outCardGame->audioEngine, SOUND_HOVER,
-			MA_SOUND_FLAG_DECODE | MA_SOUND_FLAG_STREAM, nullptr, nullptr, &outCardGame->hoverAudio);
-		assert(result == MA_SUCCESS);
-
-		result = ma_sound_init_from_file(&outCardGame->audioEngine, SOUND_CLICK,
-			MA_SOUND_FLAG_DECODE | MA_SOUND_FLAG_STREAM, nullptr, nullptr, &outCardGame->clickAudio);
-		assert(result == MA_SUCCESS);
-
-		for (uint32_t i = 0; i < 9; i++)
 		{
-			const auto scope = mem.tempArena.CreateScope();
-			const char* c = TextInterpreter::IntToConstCharPtr(i, mem.tempArena);
-			const char* str = TextInterpreter::Concat("Audio/atk", c, mem.tempArena);
-			str = TextInterpreter::Concat(str, ".wav", mem.tempArena);
-			result = ma_sound_init_from_file(&outCardGame->audioEngine, str,
-				MA_SOUND_FLAG_DECODE | MA_SOUND_FLAG_STREAM, nullptr, nullptr, &outCardGame->attackAudios[i]);
-			assert(result == MA_SUCCESS);
-			mem.tempArena.DestroyScope(scope);
-		}
+			const auto tempScope = mem.tempArena.CreateScope();
 
-		for (uint32_t i = 0; i < 6; i++)
-		{
-			const auto scope = mem.tempArena.CreateScope();
-			const char* c = TextInterpreter::IntToConstCharPtr(i, mem.tempArena);
-			const char* str = TextInterpreter::Concat("Audio/dmg", c, mem.tempArena);
-			str = TextInterpreter::Concat(str, ".wav", mem.tempArena);
-			result = ma_sound_init_from_file(&outCardGame->audioEngine, str,
-				MA_SOUND_FLAG_DECODE | MA_SOUND_FLAG_STREAM, nullptr, nullptr, &outCardGame->damagedAudios[i]);
-			assert(result == MA_SUCCESS);
-			mem.tempArena.DestroyScope(scope);
-		}
+			const auto paths = jv::CreateArray<const char*>(mem.tempArena, AUDIO_CLIP_COUNT);
+			paths[AUDIO_CLICK] = SOUND_CLICK;
+			paths[AUDIO_HOVER] = SOUND_HOVER;
+			for (uint32_t i = 0; i < AUDIO_ATTACK_COUNT; i++)
+			{
+				const char* c = TextInterpreter::IntToConstCharPtr(i, mem.tempArena);
+				const char* str = TextInterpreter::Concat("Audio/atk", c, mem.tempArena);
+				paths[AUDIO_ATTACK + i] = TextInterpreter::Concat(str, ".wav", mem.tempArena);
+			}
+			for (uint32_t i = 0; i < AUDIO_DAMAGED_COUNT; i++)
+			{
+				const char* c = TextInterpreter::IntToConstCharPtr(i, mem.tempArena);
+				const char* str = TextInterpreter::Concat("Audio/dmg", c, mem.tempArena);
+				paths[AUDIO_DAMAGED + i] = TextInterpreter::Concat(str, ".wav", mem.tempArena);
+			}
 
+			AudioPlayerCreateInfo audioPlayerCreateInfo{};
+			audioPlayerCreateInfo.engine = &outCardGame->audioEngine;
+			audioPlayerCreateInfo.paths = paths.ptr;
+			audioPlayerCreateInfo.pathCount = paths.length;
+			outCardGame->audioPlayer = AudioPlayer::Create(outCardGame->arena, audioPlayerCreateInfo);
 #ifdef _DEBUG
-		{
-			const auto tempScope = mem.tempArena.CreateScope();
-
-			const auto paths = cardGame.GetTexturePaths(mem.tempArena);
-			jv::ge::GenerateAtlas(outCardGame->arena, mem.tempArena, paths,
-				ATLAS_PATH, ATLAS_META_DATA_PATH);
+			outCardGame->audioPlayer.GetStats().Print();
+#endif
 
 			mem.tempArena.DestroyScope(tempScope);
 		}
+
+#ifdef _DEBUG
+		// The atlas image is written to disk while the rest of the game starts up.
+		const auto atlasTempScope = mem.tempArena.CreateScope();
+		const auto atlasPaths = cardGame.GetTexturePaths(mem.tempArena);
+		auto generatedAtlas = jv::ge::GenerateAtlas(outCardGame->arena, mem.tempArena, atlasPaths,
+			ATLAS_PATH, ATLAS_META_DATA_PATH);
 #endif
 
 		// TEMP NO RENDER GRAPH
@@ -601,16 +644,26 @@ namespace game
 			swapChain.pipeline = CreatePipeline(pipelineCreateInfo);
 		}
 
-		int texWidth, texHeight, texChannels2;
+		int texWidth, texHeight;
 		{
+#ifdef _DEBUG
+			// The encoded image might not be on disk yet.
+			stbi_uc* pixels = generatedAtlas.pixels;
+			texWidth = generatedAtlas.resolution.x;
+			texHeight = generatedAtlas.resolution.y;
+#else
+			int texChannels2;
 			stbi_uc* pixels = stbi_load(ATLAS_PATH, &texWidth, &texHeight, &texChannels2, STBI_rgb_alpha);
+#endif
 
 			jv::ge::ImageCreateInfo imageCreateInfo{};
 			imageCreateInfo.resolution = { texWidth, texHeight };
 			imageCreateInfo.scene = outCardGame->scene;
 			outCardGame->atlas = AddImage(imageCreateInfo);
 			jv::ge::FillImage(outCardGame->atlas, pixels);
+#ifndef _DEBUG
 			stbi_image_free(pixels);
+#endif
 			outCardGame->atlasTextures = jv::ge::LoadAtlasMetaData(outCardGame->arena, ATLAS_META_DATA_PATH);
 		}
 
@@ -644,7 +697,6 @@ namespace game
 
 			DynamicRenderInterpreterCreateInfo dynamicCreateInfo{};
 			dynamicCreateInfo.resolution = SIMULATED_RESOLUTION;
-			dynamicCreateInfo.frameArena = &mem.frameArena;
 			dynamicCreateInfo.drawsDirectlyToSwapChain = false;
 			dynamicCreateInfo.lightTasks = outCardGame->lightTasks;
 
@@ -776,10 +828,23 @@ namespace game
 			const auto graph = jv::rg::RenderGraph::Create(mem.arena, mem.tempArena, renderGraphCreateInfo);
 		}
 		*/
+
+#ifdef _DEBUG
+		{
+			jv::ge::AtlasGenerationTimings timings{};
+			jv::ge::FinishAtlas(generatedAtlas, &timings);
+			std::cout << "Atlas generated in " << timings.total << "ms (decode " << timings.decode << "ms, pack " << timings.pack <<
+				"ms, blit " << timings.blit << "ms), encoded in the background in " << timings.encode << "ms" << std::endl;
+			mem.tempArena.DestroyScope(atlasTempScope);
+		}
+#endif
 	}
 
 	void CardGame::Destroy(CardGame& cardGame)
 	{
+		TextureStreamer::Destroy(cardGame.largeTextureStreamer);
+		TextureStreamer::Destroy(cardGame.textureStreamer);
+		AudioPlayer::Destroy(cardGame.audioPlayer);
 		ma_engine_uninit(&cardGame.audioEngine);
 		jv::Arena::Destroy(cardGame.arena);
 		Engine::Destroy(cardGame.engine);
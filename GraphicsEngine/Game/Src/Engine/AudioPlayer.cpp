@@ -0,0 +1,274 @@
+﻿#include "pch_game.h"
+#include "Engine/AudioPlayer.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "miniaudio.h"
+#include "JLib/ArrayUtils.h"
+#include "JLib/Math.h"
+#include "JLib/QueueUtils.h"
+#include "JLib/VectorUtils.h"
+
+namespace game
+{
+	struct AudioClip final
+	{
+		float* pcm;
+		uint64_t frameCount;
+	};
+
+	struct AudioCommand final
+	{
+		uint32_t clip;
+		float volume;
+	};
+
+	struct AudioVoice final
+	{
+		ma_audio_buffer_ref buffer;
+		ma_sound sound;
+		bool initialized = false;
+		uint64_t startIndex = 0;
+	};
+
+	struct AudioMixer final
+	{
+		ma_engine* engine;
+		jv::Array<AudioClip> clips;
+		jv::Array<AudioVoice> voices;
+		jv::SPSCQueue<AudioCommand> commands;
+		std::thread thread{};
+		uint64_t startIndex = 0;
+
+		std::mutex mutex{};
+		std::condition_variable condition{};
+		std::atomic<bool> quit{ false };
+		std::atomic<uint32_t> stolenCount{ 0 };
+		std::atomic<uint32_t> droppedCount{ 0 };
+
+		float decodeTime = 0;
+		uint32_t memory = 0;
+	};
+
+	void PlayClip(AudioMixer* mixer, const AudioCommand& command)
+	{
+		const auto& clip = mixer->clips[command.clip];
+		if (clip.frameCount == 0)
+			return;
+
+		// Prefer a voice that has finished playing, otherwise steal the oldest one.
+		AudioVoice* voice = nullptr;
+		for (auto& v : mixer->voices)
+		{
+			if (!v.initialized || !ma_sound_is_playing(&v.sound))
+			{
+				voice = &v;
+				break;
+			}
+			if (!voice || v.startIndex < voice->startIndex)
+				voice = &v;
+		}
+
+		// The audio device might still be reading from a voice that is playing, so detach it before swapping the clip.
+		if (voice->initialized && ma_sound_is_playing(&voice->sound))
+		{
+			ma_sound_uninit(&voice->sound);
+			voice->initialized = false;
+			++mixer->stolenCount;
+		}
+
+		auto result = ma_audio_buffer_ref_set_data(&voice->buffer, clip.pcm, clip.frameCount);
+		assert(result == MA_SUCCESS);
+
+		if (!voice->initialized)
+		{
+			result = ma_sound_init_from_data_source(mixer->engine, &voice->buffer,
+				MA_SOUND_FLAG_NO_PITCH | MA_SOUND_FLAG_NO_SPATIALIZATION, nullptr, &voice->sound);
+			if (result != MA_SUCCESS)
+			{
+				++mixer->droppedCount;
+				return;
+			}
+			voice->initialized = true;
+		}
+
+		ma_sound_seek_to_pcm_frame(&voice->sound, 0);
+		ma_sound_set_volume(&voice->sound, command.volume);
+		ma_sound_start(&voice->sound);
+		voice->startIndex = mixer->startIndex++;
+	}
+
+	void RunAudioMixer(AudioMixer* mixer)
+	{
+		while (true)
+		{
+			AudioCommand command;
+			if (!mixer->commands.TryPop(command))
+			{
+				std::unique_lock<std::mutex> lock(mixer->mutex);
+				mixer->condition.wait(lock, [mixer]
+				{
+					return mixer->quit.load() || mixer->commands.GetCount() > 0;
+				});
+				if (mixer->quit.load())
+					return;
+				continue;
+			}
+
+			PlayClip(mixer, command);
+		}
+	}
+
+	void AudioStats::Print() const
+	{
+		std::cout << "[Audio] clips: " << clipCount << ", decoded in: " << decodeTime << " ms, memory: " << memory <<
+			" B, voices: " << voiceCount << ", stolen: " << stolenCount << ", dropped: " << droppedCount << std::endl;
+	}
+
+	void AudioPlayer::Play(const uint32_t clip, const float volume)
+	{
+		assert(clip < _clipCount);
+
+		for (auto& trigger : _triggers)
+			if (trigger.clip == clip)
+			{
+				trigger.volume = jv::Max(trigger.volume, volume);
+				return;
+			}
+
+		if (_triggers.count == _triggers.length)
+		{
+			++_mixer->droppedCount;
+			return;
+		}
+
+		auto& trigger = _triggers.Add();
+		trigger.clip = clip;
+		trigger.volume = volume;
+	}
+
+	void AudioPlayer::Update()
+	{
+		if (_triggers.count == 0)
+			return;
+
+		for (const auto& trigger : _triggers)
+		{
+			AudioCommand command{};
+			command.clip = trigger.clip;
+			command.volume = trigger.volume;
+			// The audio thread is too far behind, so this sound would be late anyway.
+			if (!_mixer->commands.TryAdd(command))
+				++_mixer->droppedCount;
+		}
+		_triggers.Clear();
+
+		{
+			std::lock_guard<std::mutex> lock(_mixer->mutex);
+		}
+		_mixer->condition.notify_one();
+	}
+
+	AudioStats AudioPlayer::GetStats() const
+	{
+		AudioStats stats{};
+		stats.decodeTime = _mixer->decodeTime;
+		stats.memory = _mixer->memory;
+		stats.clipCount = _clipCount;
+		stats.voiceCount = _mixer->voices.length;
+		stats.stolenCount = _mixer->stolenCount.load();
+		stats.droppedCount = _mixer->droppedCount.load();
+		return stats;
+	}
+
+	AudioPlayer AudioPlayer::Create(jv::Arena& arena, const AudioPlayerCreateInfo& info)
+	{
+		assert(info.engine);
+		assert(info.voiceCount > 0);
+		assert(info.triggerCapacity > 0);
+
+		AudioPlayer player{};
+		player._arena = &arena;
+		player._scope = arena.CreateScope();
+		player._clipCount = info.pathCount;
+		player._triggers = jv::CreateVector<Trigger>(arena, info.triggerCapacity);
+
+		const auto mixer = player._mixer = arena.New<AudioMixer>();
+		mixer->engine = info.engine;
+		mixer->clips = jv::CreateArray<AudioClip>(arena, info.pathCount);
+		mixer->voices = jv::CreateArray<AudioVoice>(arena, info.voiceCount);
+		for (auto& voice : mixer->voices)
+			voice = {};
+
+		uint32_t queueLength = 1;
+		while (queueLength < info.triggerCapacity * 2)
+			queueLength *= 2;
+		mixer->commands = jv::CreateSPSCQueue<AudioCommand>(arena, queueLength);
+
+		// Decode to the engine's format, so that playing a clip doesn't need any conversion.
+		const auto channels = ma_engine_get_channels(info.engine);
+		const auto sampleRate = ma_engine_get_sample_rate(info.engine);
+		const auto start = std::chrono::high_resolution_clock::now();
+
+		for (uint32_t i = 0; i < info.pathCount; ++i)
+		{
+			auto& clip = mixer->clips[i];
+			clip = {};
+
+			auto config = ma_decoder_config_init(ma_format_f32, channels, sampleRate);
+			ma_decoder decoder;
+			auto result = ma_decoder_init_file(info.paths[i], &config, &decoder);
+			assert(result == MA_SUCCESS);
+			if (result != MA_SUCCESS)
+				continue;
+
+			ma_uint64 frameCount = 0;
+			result = ma_decoder_get_length_in_pcm_frames(&decoder, &frameCount);
+			assert(result == MA_SUCCESS);
+
+			const auto size = static_cast<uint32_t>(frameCount * channels * sizeof(float));
+			clip.pcm = static_cast<float*>(arena.Alloc(size, alignof(float)));
+			ma_uint64 readCount = 0;
+			ma_decoder_read_pcm_frames(&decoder, clip.pcm, frameCount, &readCount);
+			clip.frameCount = readCount;
+			mixer->memory += size;
+
+			ma_decoder_uninit(&decoder);
+		}
+
+		mixer->decodeTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+		for (auto& voice : mixer->voices)
+		{
+			const auto result = ma_audio_buffer_ref_init(ma_format_f32, channels, nullptr, 0, &voice.buffer);
+			assert(result == MA_SUCCESS);
+		}
+
+		mixer->thread = std::thread(RunAudioMixer, mixer);
+		return player;
+	}
+
+	void AudioPlayer::Destroy(const AudioPlayer& player)
+	{
+		const auto mixer = player._mixer;
+		{
+			std::lock_guard<std::mutex> lock(mixer->mutex);
+			mixer->quit = true;
+		}
+		mixer->condition.notify_all();
+		mixer->thread.join();
+
+		for (auto& voice : mixer->voices)
+		{
+			if (voice.initialized)
+				ma_sound_uninit(&voice.sound);
+			ma_audio_buffer_ref_uninit(&voice.buffer);
+		}
+		mixer->~AudioMixer();
+
+		player._arena->DestroyScope(player._scope);
+	}
+}
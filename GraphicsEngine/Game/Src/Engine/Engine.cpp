@@ -2,6 +2,11 @@
 #include "Engine/Engine.h"
 
 #include "GE/GraphicsEngine.h"
+#include "JLib/ArrayUtils.h"
+#include "JLib/Math.h"
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 
 namespace game
 {
@@ -15,19 +20,92 @@ namespace game
 		return free(ptr);
 	}
 
+	constexpr uint32_t MAIN_THREAD_INDEX = UINT32_MAX - 1;
+	constexpr uint32_t RENDER_THREAD_INDEX = UINT32_MAX - 2;
+
+	jv::ChunkPool frameChunkPool{};
+	bool trackArenaStats = false;
+	jv::ArenaStats arenaStats{ "Engine arena" };
+	jv::ArenaStats tempArenaStats{ "Engine temp arena" };
+	jv::ArenaStats frameArenaStats{ "Engine frame arena" };
+	thread_local uint32_t threadFrameArenaIndex = UINT32_MAX;
+	// Frame arena of the task interpreter that is being updated on this thread.
+	thread_local jv::Arena* interpreterFrameArena = nullptr;
+	// Staging slot of the task interpreter that is being updated on this thread.
+	thread_local uint32_t interpreterStagingIndex = 0;
+
+	struct RenderThreadState final
+	{
+		std::thread thread{};
+		std::mutex mutex{};
+		std::condition_variable condition{};
+		bool(*customRenderFunc)(void* userPtr) = nullptr;
+		void* userPtr = nullptr;
+		// Whether the render thread has a frame to render.
+		bool busy = false;
+		bool result = true;
+		bool quit = false;
+	};
+
+	void* ChunkAlloc(const uint32_t size)
+	{
+		return frameChunkPool.Alloc(size);
+	}
+
+	void ChunkFree(void* ptr)
+	{
+		frameChunkPool.Free(ptr);
+	}
+
 	EngineMemory::EngineMemory(jv::Arena& arena, jv::Arena& tempArena, jv::Arena& frameArena) :
 		arena(arena), tempArena(tempArena), frameArena(frameArena)
 	{
 
 	}
 
-	void* ITaskInterpreter::GetTaskSystemPtr() const
+	jv::Arena& ITaskSystem::GetThreadFrameArena(jv::Arena& fallback)
+	{
+		return interpreterFrameArena ? *interpreterFrameArena : fallback;
+	}
+
+	uint32_t ITaskSystem::GetStagingIndex()
+	{
+		return interpreterStagingIndex;
+	}
+
+	ITaskSystem* ITaskInterpreter::GetTaskSystemPtr() const
 	{
 		return _taskSystem;
 	}
 
+	void ITaskInterpreter::DeclareGraphicsAccess()
+	{
+		_graphicsAccess = true;
+	}
+
+	bool ITaskInterpreter::Reads(const ITaskSystem* taskSystem) const
+	{
+		if (_taskSystem == taskSystem)
+			return true;
+		for (uint32_t i = 0; i < _readCount; ++i)
+			if (_reads[i] == taskSystem)
+				return true;
+		return false;
+	}
+
+	bool ITaskInterpreter::Writes(const ITaskSystem* taskSystem) const
+	{
+		for (uint32_t i = 0; i < _writeCount; ++i)
+			if (_writes[i] == taskSystem)
+				return true;
+		return false;
+	}
+
 	bool Engine::Update(bool(*customRenderFunc)(void* userPtr), void* userPtr)
 	{
+		if (_renderThread)
+			return UpdateWithRenderThread(customRenderFunc, userPtr);
+
 		if(!customRenderFunc)
 		{
 			const bool waitForImage = jv::ge::WaitForImage();
@@ -35,10 +113,88 @@ namespace game
 				return false;
 		}
 
-		const auto memory = GetMemory();
-		
-		for (const auto& interpreter : _taskInterpreters)
-			interpreter->Update(memory);
+		if (_interpreterCount != _taskInterpreters.GetCount())
+			BuildInterpreterGraph();
+		if (!Render(customRenderFunc, userPtr))
+			return false;
+
+		// Clear tasks.
+		for (const auto& taskSystem : _taskSystems)
+			if(taskSystem->autoClear)
+				taskSystem->ClearTasks();
+
+		if (trackArenaStats)
+		{
+			arenaStats.EndFrame();
+			tempArenaStats.EndFrame();
+			frameArenaStats.EndFrame();
+		}
+
+		// Clear frame arenas.
+		_frameArena.Clear();
+		const uint32_t threadFrameArenaCount = jv::Min(_claimedThreadFrameArenas->load(), _threadFrameArenaCount);
+		for (uint32_t i = 0; i < threadFrameArenaCount; ++i)
+			_threadFrameArenas[i].Reset();
+		return true;
+	}
+
+	void Engine::WaitForRenderThread() const
+	{
+		if (!_renderThread)
+			return;
+
+		std::unique_lock<std::mutex> lock(_renderThread->mutex);
+		_renderThread->condition.wait(lock, [this] { return !_renderThread->busy; });
+	}
+
+	bool Engine::UpdateWithRenderThread(bool(*customRenderFunc)(void* userPtr), void* userPtr)
+	{
+		// Window events can only be handled on the main thread.
+		if (!jv::ge::PollEvents())
+			return false;
+
+		WaitForRenderThread();
+		if (!_renderThread->result)
+			return false;
+
+		// Started here since the engine is moved after creation.
+		if (!_renderThread->thread.joinable())
+			_renderThread->thread = std::thread(RunRenderThread, this);
+
+		if (_interpreterCount != _taskInterpreters.GetCount())
+			BuildInterpreterGraph();
+
+		// Hand the tasks of this frame over to the render thread, and start the next frame with the arena it is done with.
+		std::swap(_frameArena, _renderFrameArena);
+		_frameArena.Clear();
+		for (const auto& taskSystem : _taskSystems)
+			taskSystem->SwapBuffers(_renderFrameArena);
+
+		const uint32_t threadFrameArenaCount = jv::Min(_claimedThreadFrameArenas->load(), _threadFrameArenaCount);
+		for (uint32_t i = 0; i < threadFrameArenaCount; ++i)
+			_threadFrameArenas[i].Reset();
+		_renderThreadFrameArena.Reset();
+
+		if (trackArenaStats)
+		{
+			arenaStats.EndFrame();
+			tempArenaStats.EndFrame();
+			frameArenaStats.EndFrame();
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(_renderThread->mutex);
+			_renderThread->customRenderFunc = customRenderFunc;
+			_renderThread->userPtr = userPtr;
+			_renderThread->busy = true;
+		}
+		_renderThread->condition.notify_all();
+		return true;
+	}
+
+	bool Engine::Render(bool(*customRenderFunc)(void* userPtr), void* userPtr)
+	{
+		_jobSystem.Run(_interpreterJobs, _interpreterJobCount);
 
 		// Update renderer.
 		if(customRenderFunc)
@@ -49,15 +205,33 @@ namespace game
 			if (!RenderFrame(renderFrameInfo))
 				return false;
 		}
+		return true;
+	}
 
-		// Clear tasks.
-		for (const auto& taskSystem : _taskSystems)
-			if(taskSystem->autoClear)
-				taskSystem->ClearTasks();
+	void Engine::RunRenderThread(Engine* engine)
+	{
+		auto& state = *engine->_renderThread;
+		threadFrameArenaIndex = RENDER_THREAD_INDEX;
+		// Unbatched draws made by the custom render function are recorded in the render thread's own slot.
+		jv::ge::SetRenderFrameThreadIndex(engine->GetDrawBatchThreadIndex());
 
-		// Clear frame arena.
-		_frameArena.Clear();
-		return true;
+		while (true)
+		{
+			std::unique_lock<std::mutex> lock(state.mutex);
+			state.condition.wait(lock, [&state] { return state.busy || state.quit; });
+			if (!state.busy)
+				return;
+			lock.unlock();
+
+			// Interpreters use the frame index, so the image has to be acquired before they are updated.
+			const bool result = jv::ge::WaitForImage(false) && engine->Render(state.customRenderFunc, state.userPtr);
+
+			lock.lock();
+			state.result = result;
+			state.busy = false;
+			lock.unlock();
+			state.condition.notify_all();
+		}
 	}
 
 	Engine Engine::Create(const EngineCreateInfo& info)
@@ -71,30 +245,130 @@ namespace game
 		createInfo.fullscreen = info.fullScreen;
 		createInfo.name = info.name;
 		createInfo.icon = info.icon;
+		createInfo.trackArenaStats = info.trackArenaStats;
+		// Every thread with a thread frame arena can record draw batches, as well as the main thread and the render thread.
+		createInfo.drawBatchThreadCount = info.threadFrameArenaCount + (info.renderThread ? 2 : 1);
+		createInfo.drawBatchCapacity = info.taskInterpreterCapacity + 1;
 		Initialize(createInfo);
 
 		Engine engine{};
 		engine._arenaMem = malloc(info.arenaSize);
-		engine._tempArenaMem = malloc(info.frameArenaSize);
-		engine._frameArenaMem = malloc(info.tempArenaSize);
+		engine._tempArenaMem = malloc(info.tempArenaSize);
+		engine._frameArenaMem = malloc(info.frameArenaSize);
+
+		trackArenaStats = info.trackArenaStats;
 
 		jv::ArenaCreateInfo arenaCreateInfo{};
 		arenaCreateInfo.alloc = Alloc;
 		arenaCreateInfo.free = Free;
 		arenaCreateInfo.memorySize = info.arenaSize;
 		arenaCreateInfo.memory = engine._arenaMem;
+		arenaCreateInfo.stats = trackArenaStats ? &arenaStats : nullptr;
 		engine._arena = jv::Arena::Create(arenaCreateInfo);
 		arenaCreateInfo.memorySize = info.tempArenaSize;
 		arenaCreateInfo.memory = engine._tempArenaMem;
+		arenaCreateInfo.stats = trackArenaStats ? &tempArenaStats : nullptr;
 		engine._tempArena = jv::Arena::Create(arenaCreateInfo);
 		arenaCreateInfo.memorySize = info.frameArenaSize;
 		arenaCreateInfo.memory = engine._frameArenaMem;
+		arenaCreateInfo.stats = trackArenaStats ? &frameArenaStats : nullptr;
 		engine._frameArena = jv::Arena::Create(arenaCreateInfo);
+
+		if (info.renderThread)
+		{
+			// Both frame arenas share their stats, since they take turns being the frame arena.
+			engine._renderFrameArenaMem = malloc(info.frameArenaSize);
+			arenaCreateInfo.memory = engine._renderFrameArenaMem;
+			engine._renderFrameArena = jv::Arena::Create(arenaCreateInfo);
+
+			// Stats aren't shared with the game thread's temp arena, since they aren't thread safe.
+			engine._renderTempArenaMem = malloc(info.tempArenaSize);
+			arenaCreateInfo.memorySize = info.tempArenaSize;
+			arenaCreateInfo.memory = engine._renderTempArenaMem;
+			arenaCreateInfo.stats = nullptr;
+			engine._renderTempArena = jv::Arena::Create(arenaCreateInfo);
+			engine._renderThread = engine._arena.New<RenderThreadState>();
+		}
+
+		jv::ChunkPoolCreateInfo chunkPoolCreateInfo{};
+		chunkPoolCreateInfo.alloc = Alloc;
+		chunkPoolCreateInfo.free = Free;
+		chunkPoolCreateInfo.chunkSize = info.frameArenaSize;
+		chunkPoolCreateInfo.chunkCount = info.frameChunkCount;
+		frameChunkPool = jv::ChunkPool::Create(engine._arena, chunkPoolCreateInfo);
+
+		if (info.renderThread)
+		{
+			jv::ArenaCreateInfo renderThreadArenaCreateInfo{};
+			renderThreadArenaCreateInfo.memorySize = info.frameArenaSize;
+			renderThreadArenaCreateInfo.alloc = ChunkAlloc;
+			renderThreadArenaCreateInfo.free = ChunkFree;
+			engine._renderThreadFrameArena = jv::Arena::Create(renderThreadArenaCreateInfo);
+		}
+
+		engine._threadFrameArenaCount = info.threadFrameArenaCount;
+		engine._threadFrameArenas = engine._arena.New<jv::Arena>(info.threadFrameArenaCount);
+		engine._claimedThreadFrameArenas = engine._arena.New<std::atomic<uint32_t>>();
+		engine._claimedThreadFrameArenas->store(0);
+		threadFrameArenaIndex = MAIN_THREAD_INDEX;
+
+		// Every job thread claims a thread frame arena, the main thread and the render thread have their own.
+		const uint32_t reservedThreadCount = info.renderThread ? 2 : 1;
+		const uint32_t coreCount = jv::Max<uint32_t>(std::thread::hardware_concurrency(), reservedThreadCount);
+		JobSystemCreateInfo jobSystemCreateInfo{};
+		jobSystemCreateInfo.threadCount = jv::Min(jv::Min(info.jobThreadCount, coreCount - reservedThreadCount), 
+			info.threadFrameArenaCount);
+		// One job per task interpreter, and one per task system that needs its staged tasks merged.
+		jobSystemCreateInfo.capacity = info.taskInterpreterCapacity * 2;
+		engine._jobSystem = JobSystem::Create(engine._arena, jobSystemCreateInfo);
+		engine._taskInterpreterCapacity = info.taskInterpreterCapacity;
+
+		const uint32_t maxJobCount = jobSystemCreateInfo.capacity;
+		engine._interpreterJobs = engine._arena.New<Job>(maxJobCount);
+		engine._interpreterJobInfos = engine._arena.New<JobInfo>(maxJobCount);
+		engine._interpreterJobDependents = engine._arena.New<uint32_t>(maxJobCount * maxJobCount);
 		return engine;
 	}
 
 	void Engine::Destroy(const Engine& engine)
 	{
+		if (engine._renderThread)
+		{
+			auto& state = *engine._renderThread;
+			{
+				std::lock_guard<std::mutex> lock(state.mutex);
+				state.quit = true;
+			}
+			state.condition.notify_all();
+			if (state.thread.joinable())
+				state.thread.join();
+			state.~RenderThreadState();
+		}
+
+		JobSystem::Destroy(engine._jobSystem);
+
+		const uint32_t threadFrameArenaCount = jv::Min(engine._claimedThreadFrameArenas->load(), engine._threadFrameArenaCount);
+		for (uint32_t i = 0; i < threadFrameArenaCount; ++i)
+			jv::Arena::Destroy(engine._threadFrameArenas[i]);
+		if (engine._renderThread)
+			jv::Arena::Destroy(engine._renderThreadFrameArena);
+		jv::ChunkPool::Destroy(frameChunkPool);
+		threadFrameArenaIndex = UINT32_MAX;
+
+		if (trackArenaStats)
+		{
+			arenaStats.Print();
+			tempArenaStats.Print();
+			frameArenaStats.Print();
+		}
+
+		if (engine._renderThread)
+		{
+			jv::Arena::Destroy(engine._renderTempArena);
+			free(engine._renderTempArenaMem);
+			jv::Arena::Destroy(engine._renderFrameArena);
+			free(engine._renderFrameArenaMem);
+		}
 		jv::Arena::Destroy(engine._frameArena);
 		jv::Arena::Destroy(engine._tempArena);
 		jv::Arena::Destroy(engine._arena);
@@ -105,6 +379,9 @@ namespace game
 
 	EngineMemory Engine::GetMemory()
 	{
+		// The render thread gets its own arenas, so it doesn't interfere with the game thread.
+		if (threadFrameArenaIndex == RENDER_THREAD_INDEX)
+			return { _arena, _renderTempArena, _renderThreadFrameArena };
 		return {_arena, _tempArena, _frameArena };
 	}
 
@@ -112,12 +389,190 @@ namespace game
 	{
 		jv::ArenaCreateInfo info{};
 		info.memorySize = size;
-		info.memory = _arena.Alloc(size);
+		info.memory = _arena.Alloc(size, alignof(jv::Arena));
 		info.alloc = Alloc;
 		info.free = Free;
 		return jv::Arena::Create(info);
 	}
 
+	jv::Arena& Engine::GetThreadFrameArena()
+	{
+		if (threadFrameArenaIndex == MAIN_THREAD_INDEX)
+			return _frameArena;
+		if (threadFrameArenaIndex == RENDER_THREAD_INDEX)
+			return _renderThreadFrameArena;
+
+		if (threadFrameArenaIndex == UINT32_MAX)
+		{
+			const uint32_t index = _claimedThreadFrameArenas->fetch_add(1);
+			assert(index < _threadFrameArenaCount);
+
+			jv::ArenaCreateInfo info{};
+			info.memorySize = _frameArena.info.memorySize;
+			info.alloc = ChunkAlloc;
+			info.free = ChunkFree;
+			_threadFrameArenas[index] = jv::Arena::Create(info);
+			threadFrameArenaIndex = index;
+		}
+
+		return _threadFrameArenas[threadFrameArenaIndex];
+	}
+
+	jv::Arena& Engine::GetThreadTempArena()
+	{
+		if (threadFrameArenaIndex == MAIN_THREAD_INDEX)
+			return _tempArena;
+		if (threadFrameArenaIndex == RENDER_THREAD_INDEX)
+			return _renderTempArena;
+		return GetThreadFrameArena();
+	}
+
+	uint32_t Engine::GetDrawBatchThreadIndex() const
+	{
+		// Thread index 0 is used by the main thread, the render thread comes after the thread frame arenas.
+		if (threadFrameArenaIndex == MAIN_THREAD_INDEX)
+			return 0;
+		if (threadFrameArenaIndex == RENDER_THREAD_INDEX)
+			return _threadFrameArenaCount + 1;
+		return threadFrameArenaIndex + 1;
+	}
+
+	void Engine::BuildInterpreterGraph()
+	{
+		const uint32_t interpreterCount = _taskInterpreters.GetCount();
+		assert(interpreterCount <= _taskInterpreterCapacity);
+
+		const auto tempScope = _tempArena.CreateScope();
+		const auto interpreters = jv::CreateArray<ITaskInterpreter*>(_tempArena, interpreterCount);
+		uint32_t index = 0;
+		for (const auto& interpreter : _taskInterpreters)
+			interpreters[index++] = interpreter;
+
+		// Every task system that is pushed to by an interpreter gets a job that merges its staged tasks.
+		const auto mergedTaskSystems = jv::CreateArray<ITaskSystem*>(_tempArena, interpreterCount * MAX_TASK_SYSTEM_ACCESS_COUNT);
+		uint32_t mergedTaskSystemCount = 0;
+		for (const auto interpreter : interpreters)
+			for (uint32_t i = 0; i < interpreter->_writeCount; ++i)
+			{
+				const auto taskSystem = interpreter->_writes[i];
+				bool found = false;
+				for (uint32_t j = 0; j < mergedTaskSystemCount; ++j)
+					found = found || mergedTaskSystems[j] == taskSystem;
+				if (!found)
+					mergedTaskSystems[mergedTaskSystemCount++] = taskSystem;
+			}
+
+		const uint32_t count = interpreterCount + mergedTaskSystemCount;
+		assert(mergedTaskSystemCount <= _taskInterpreterCapacity);
+
+		// Row i contains the jobs that have to wait for job i.
+		const auto edges = jv::CreateArray<bool>(_tempArena, count * count);
+		for (auto& edge : edges)
+			edge = false;
+
+		// Tasks are consumed in the same frame they are pushed, so writers go before the merge and the merge before readers.
+		for (uint32_t m = 0; m < mergedTaskSystemCount; ++m)
+		{
+			const auto taskSystem = mergedTaskSystems[m];
+			const uint32_t mergeIndex = interpreterCount + m;
+			for (uint32_t i = 0; i < interpreterCount; ++i)
+			{
+				if (interpreters[i]->Writes(taskSystem))
+					edges[i * count + mergeIndex] = true;
+				else if (interpreters[i]->Reads(taskSystem))
+					edges[mergeIndex * count + i] = true;
+			}
+		}
+
+		// Check for cycles by removing jobs without remaining dependencies until none are left.
+		const auto dependencyCounts = jv::CreateArray<uint32_t>(_tempArena, count);
+		for (uint32_t j = 0; j < count; ++j)
+		{
+			dependencyCounts[j] = 0;
+			for (uint32_t i = 0; i < count; ++i)
+				dependencyCounts[j] += edges[i * count + j];
+		}
+
+		{
+			const auto open = jv::CreateArray<uint32_t>(_tempArena, count);
+			const auto remaining = jv::CreateArray<uint32_t>(_tempArena, count);
+			uint32_t openCount = 0;
+			uint32_t visitedCount = 0;
+			for (uint32_t i = 0; i < count; ++i)
+			{
+				remaining[i] = dependencyCounts[i];
+				if (remaining[i] == 0)
+					open[openCount++] = i;
+			}
+
+			while (openCount > 0)
+			{
+				const uint32_t i = open[--openCount];
+				++visitedCount;
+				for (uint32_t j = 0; j < count; ++j)
+					if (edges[i * count + j] && --remaining[j] == 0)
+						open[openCount++] = j;
+			}
+
+			if (visitedCount != count)
+				throw std::exception("Task interpreter dependencies contain a cycle.");
+		}
+
+		const uint32_t maxJobCount = _taskInterpreterCapacity * 2;
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			auto& jobInfo = _interpreterJobInfos[i] = {};
+			jobInfo.engine = this;
+			jobInfo.interpreter = i < interpreterCount ? interpreters[i] : nullptr;
+			jobInfo.taskSystem = i < interpreterCount ? nullptr : mergedTaskSystems[i - interpreterCount];
+			// Staged tasks are merged in the order the interpreters were added.
+			jobInfo.stagingIndex = i < interpreterCount ? interpreterCount - i : 0;
+			jobInfo.drawOrder = i;
+
+			auto& job = _interpreterJobs[i] = {};
+			job.func = i < interpreterCount ? UpdateInterpreter : MergeStagedTasks;
+			job.userPtr = &jobInfo;
+			job.dependencyCount = dependencyCounts[i];
+
+			job.dependents = &_interpreterJobDependents[i * maxJobCount];
+			for (uint32_t j = 0; j < count; ++j)
+				if (edges[i * count + j])
+					job.dependents[job.dependentCount++] = j;
+		}
+		_interpreterJobCount = count;
+		_interpreterCount = interpreterCount;
+
+		_tempArena.DestroyScope(tempScope);
+	}
+
+	void Engine::UpdateInterpreter(void* userPtr)
+	{
+		const auto info = static_cast<JobInfo*>(userPtr);
+		auto& engine = *info->engine;
+		auto& frameArena = engine.GetThreadFrameArena();
+		interpreterFrameArena = &frameArena;
+		interpreterStagingIndex = info->stagingIndex;
+
+		const EngineMemory memory{ engine._arena, engine.GetThreadTempArena(), frameArena };
+		const bool graphicsAccess = info->interpreter->_graphicsAccess;
+		if (graphicsAccess)
+			jv::ge::BeginDrawBatch(engine.GetDrawBatchThreadIndex(), info->drawOrder);
+		info->interpreter->Update(memory);
+		if (graphicsAccess)
+			jv::ge::EndDrawBatch();
+
+		interpreterFrameArena = nullptr;
+		interpreterStagingIndex = 0;
+	}
+
+	void Engine::MergeStagedTasks(void* userPtr)
+	{
+		const auto info = static_cast<JobInfo*>(userPtr);
+		interpreterFrameArena = &info->engine->GetThreadFrameArena();
+		info->taskSystem->MergeStagedTasks();
+		interpreterFrameArena = nullptr;
+	}
+
 	glm::ivec2 Engine::GetResolution()
 	{
 		return jv::ge::GetResolution();
@@ -0,0 +1,225 @@
+﻿#include "pch_game.h"
+#include "Engine/JobSystem.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace game
+{
+	constexpr uint32_t NO_JOB = UINT32_MAX;
+
+	// Fixed size work stealing deque (Chase-Lev). The owning thread pushes and pops at the bottom, other threads steal from the top.
+	// The positions are never reset, so a stale read from a previous run can never be mistaken for a valid one.
+	struct JobDeque final
+	{
+		alignas(jv::CACHE_LINE_SIZE) std::atomic<int64_t> top{ 0 };
+		alignas(jv::CACHE_LINE_SIZE) std::atomic<int64_t> bottom{ 0 };
+		std::atomic<uint32_t>* jobs = nullptr;
+		uint32_t mask = 0;
+
+		void Push(uint32_t job);
+		[[nodiscard]] uint32_t Pop();
+		[[nodiscard]] uint32_t Steal();
+	};
+
+	struct JobSystemState final
+	{
+		JobDeque* deques = nullptr;
+		std::thread* threads = nullptr;
+		std::atomic<uint32_t>* dependencyCounts = nullptr;
+		uint32_t threadCount = 0;
+		uint32_t capacity = 0;
+
+		const Job* jobs = nullptr;
+		std::atomic<uint32_t> remaining{ 0 };
+
+		std::mutex mutex{};
+		std::condition_variable condition{};
+		uint64_t generation = 0;
+		bool quit = false;
+	};
+
+	void JobDeque::Push(const uint32_t job)
+	{
+		const int64_t b = bottom.load(std::memory_order_relaxed);
+		jobs[b & mask].store(job, std::memory_order_relaxed);
+		bottom.store(b + 1);
+	}
+
+	uint32_t JobDeque::Pop()
+	{
+		const int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+		bottom.store(b);
+		int64_t t = top.load();
+
+		if (t > b)
+		{
+			bottom.store(b + 1);
+			return NO_JOB;
+		}
+
+		const uint32_t job = jobs[b & mask].load(std::memory_order_relaxed);
+		if (t == b)
+		{
+			// Last job in the deque, so race the stealing threads for it.
+			const bool won = top.compare_exchange_strong(t, t + 1);
+			bottom.store(b + 1);
+			return won ? job : NO_JOB;
+		}
+		return job;
+	}
+
+	uint32_t JobDeque::Steal()
+	{
+		int64_t t = top.load();
+		const int64_t b = bottom.load();
+		if (t >= b)
+			return NO_JOB;
+
+		const uint32_t job = jobs[t & mask].load(std::memory_order_relaxed);
+		return top.compare_exchange_strong(t, t + 1) ? job : NO_JOB;
+	}
+
+	uint32_t FindJob(JobSystemState& state, const uint32_t threadIndex)
+	{
+		uint32_t job = state.deques[threadIndex].Pop();
+		if (job != NO_JOB)
+			return job;
+
+		const uint32_t dequeCount = state.threadCount + 1;
+		for (uint32_t i = 1; i < dequeCount; ++i)
+		{
+			job = state.deques[(threadIndex + i) % dequeCount].Steal();
+			if (job != NO_JOB)
+				return job;
+		}
+		return NO_JOB;
+	}
+
+	void ExecuteJob(JobSystemState& state, const uint32_t threadIndex, const uint32_t job)
+	{
+		const Job& current = state.jobs[job];
+		current.func(current.userPtr);
+
+		for (uint32_t i = 0; i < current.dependentCount; ++i)
+		{
+			const uint32_t dependent = current.dependents[i];
+			if (state.dependencyCounts[dependent].fetch_sub(1, std::memory_order_acq_rel) == 1)
+				state.deques[threadIndex].Push(dependent);
+		}
+
+		state.remaining.fetch_sub(1, std::memory_order_release);
+	}
+
+	// Keeps executing jobs until every job of the current run is done.
+	void WorkUntilDone(JobSystemState& state, const uint32_t threadIndex)
+	{
+		while (state.remaining.load(std::memory_order_acquire) > 0)
+		{
+			const uint32_t job = FindJob(state, threadIndex);
+			if (job == NO_JOB)
+			{
+				std::this_thread::yield();
+				continue;
+			}
+			ExecuteJob(state, threadIndex, job);
+		}
+	}
+
+	void RunWorker(JobSystemState* state, const uint32_t threadIndex)
+	{
+		uint64_t generation = 0;
+		while (true)
+		{
+			{
+				std::unique_lock<std::mutex> lock(state->mutex);
+				state->condition.wait(lock, [state, generation] { return state->quit || state->generation != generation; });
+				if (state->quit)
+					return;
+				generation = state->generation;
+			}
+
+			WorkUntilDone(*state, threadIndex);
+		}
+	}
+
+	void JobSystem::Run(const Job* jobs, const uint32_t count) const
+	{
+		assert(count <= _state->capacity);
+		if (count == 0)
+			return;
+
+		_state->jobs = jobs;
+		for (uint32_t i = 0; i < count; ++i)
+			_state->dependencyCounts[i].store(jobs[i].dependencyCount, std::memory_order_relaxed);
+		// Has to be set before the first job becomes visible to the other threads.
+		_state->remaining.store(count, std::memory_order_release);
+		for (uint32_t i = 0; i < count; ++i)
+			if (jobs[i].dependencyCount == 0)
+				_state->deques[0].Push(i);
+
+		if (_state->threadCount > 0)
+		{
+			{
+				std::lock_guard<std::mutex> lock(_state->mutex);
+				++_state->generation;
+			}
+			_state->condition.notify_all();
+		}
+
+		// The calling thread always uses the first deque.
+		WorkUntilDone(*_state, 0);
+	}
+
+	uint32_t JobSystem::GetThreadCount() const
+	{
+		return _state->threadCount;
+	}
+
+	JobSystem JobSystem::Create(jv::Arena& arena, const JobSystemCreateInfo& info)
+	{
+		assert(info.capacity > 0);
+
+		uint32_t dequeLength = 1;
+		while (dequeLength < info.capacity)
+			dequeLength *= 2;
+
+		JobSystem jobSystem{};
+		jobSystem._state = arena.New<JobSystemState>();
+		auto& state = *jobSystem._state;
+		state.threadCount = info.threadCount;
+		state.capacity = info.capacity;
+		state.dependencyCounts = arena.New<std::atomic<uint32_t>>(info.capacity);
+		state.deques = arena.New<JobDeque>(info.threadCount + 1);
+		for (uint32_t i = 0; i <= info.threadCount; ++i)
+		{
+			state.deques[i].jobs = arena.New<std::atomic<uint32_t>>(dequeLength);
+			state.deques[i].mask = dequeLength - 1;
+		}
+
+		if (info.threadCount > 0)
+			state.threads = static_cast<std::thread*>(arena.Alloc(sizeof(std::thread) * info.threadCount, alignof(std::thread)));
+		for (uint32_t i = 0; i < info.threadCount; ++i)
+			new(&state.threads[i]) std::thread(RunWorker, &state, i + 1);
+		return jobSystem;
+	}
+
+	void JobSystem::Destroy(const JobSystem& jobSystem)
+	{
+		auto& state = *jobSystem._state;
+		{
+			std::lock_guard<std::mutex> lock(state.mutex);
+			state.quit = true;
+		}
+		state.condition.notify_all();
+
+		for (uint32_t i = 0; i < state.threadCount; ++i)
+		{
+			state.threads[i].join();
+			state.threads[i].~thread();
+		}
+		state.~JobSystemState();
+	}
+}
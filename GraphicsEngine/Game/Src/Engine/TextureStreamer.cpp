@@ -2,13 +2,79 @@
 #include "Engine/TextureStreamer.h"
 
 #include <stb_image.h>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 
 #include "JLib/ArrayUtils.h"
+#include "JLib/HashMapUtils.h"
 #include "JLib/LinkedListUtils.h"
+#include "JLib/QueueUtils.h"
 #include "JLib/VectorUtils.h"
 
 namespace game
 {
+	struct TextureDecodeRequest final
+	{
+		uint32_t id;
+		const char* path;
+	};
+
+	struct TextureDecodeResult final
+	{
+		uint32_t id;
+		stbi_uc* pixels;
+		glm::ivec2 resolution;
+	};
+
+	struct TextureDecoder final
+	{
+		jv::MPMCQueue<TextureDecodeRequest> requests;
+		jv::MPMCQueue<TextureDecodeResult> results;
+		std::thread* threads = nullptr;
+		uint32_t threadCount = 0;
+
+		std::mutex mutex{};
+		std::condition_variable condition{};
+		std::atomic<bool> quit{ false };
+	};
+
+	void RunTextureDecoder(TextureDecoder* decoder)
+	{
+		while (true)
+		{
+			TextureDecodeRequest request;
+			if (!decoder->requests.TryPop(request))
+			{
+				std::unique_lock<std::mutex> lock(decoder->mutex);
+				decoder->condition.wait(lock, [decoder]
+				{
+					return decoder->quit.load() || decoder->requests.GetCount() > 0;
+				});
+				if (decoder->quit.load())
+					return;
+				continue;
+			}
+
+			int texWidth, texHeight, texChannels2;
+			TextureDecodeResult result{};
+			result.id = request.id;
+			result.pixels = stbi_load(request.path, &texWidth, &texHeight, &texChannels2, STBI_rgb_alpha);
+			result.resolution = { texWidth, texHeight };
+
+			// The results are only emptied on the main thread, so wait for it to catch up.
+			while (!decoder->results.TryAdd(result))
+			{
+				if (decoder->quit.load())
+				{
+					stbi_image_free(result.pixels);
+					return;
+				}
+				std::this_thread::yield();
+			}
+		}
+	}
+
 	jv::ge::Resource TextureStreamer::Get(const uint32_t i, uint32_t* outFrameCount)
 	{
 		if (i == -1)
@@ -16,78 +82,81 @@ namespace game
 
 		auto& id = _ids[i];
 		assert(id.path);
-		if (id.resource)
+		id.inactiveCount = 0;
+
+		if (id.state == Id::State::ready)
 		{
-			id.inactiveCount = 0;
 			if (outFrameCount)
 				*outFrameCount = id.frameCount;
 			return id.resource->resource;
 		}
 
-		// Find a new resource to link it to.
-		for (auto& pool : _pools)
-		{
-			bool found = false;
-			for (auto& resource : pool)
-			{
-				if (!resource.active)
-				{
-					id.resource = &resource;
-					found = true;
-					break;
-				}
-			}
-			if (found)
-				break;
-		}
+		if (outFrameCount)
+			*outFrameCount = 1;
+		if (id.state == Id::State::loading)
+			return nullptr;
+
+		// Try again next time if the decoder is too busy.
+		TextureDecodeRequest request{};
+		request.id = i;
+		request.path = id.path;
+		if (!_decoder->requests.TryAdd(request))
+			return nullptr;
 
-		// Make new resource if no available one exists.
-		if(!id.resource)
 		{
-			Resource* resource = nullptr;
-			for (auto& pool : _pools)
-			{
-				if (pool.count != pool.length)
-				{
-					resource = &pool.Add();
-					break;
-				}
-			}
-			if (!resource)
-			{
-				auto& pool = Add(*_arena, _pools);
-				pool = jv::CreateVector<Resource>(*_arena, _poolChunkSize);
-				resource = &pool.Add();
-			}
-			
-			resource->resource = AddImage(_imageCreateInfo);
-			id.resource = resource;
+			std::lock_guard<std::mutex> lock(_decoder->mutex);
 		}
+		_decoder->condition.notify_one();
 
-		int texWidth, texHeight, texChannels2;
-		stbi_uc* pixels = stbi_load(id.path, &texWidth, &texHeight, &texChannels2, STBI_rgb_alpha);
-		assert(pixels);
-		glm::ivec2 resolution{ texWidth, texHeight };
-		jv::ge::FillImage(id.resource->resource, pixels, &resolution);
-		stbi_image_free(pixels);
+		id.resource = ClaimResource();
 		id.resource->active = true;
-		id.inactiveCount = 0;
-		id.frameCount = static_cast<uint32_t>(texWidth) / _frameWidth;
-		if (outFrameCount)
-			*outFrameCount = id.frameCount;
-		return id.resource->resource;
+		id.state = Id::State::loading;
+		return nullptr;
+	}
+
+	bool TextureStreamer::IsReady(const uint32_t i) const
+	{
+		return _ids[i].state == Id::State::ready;
 	}
 
 	uint32_t TextureStreamer::DefineTexturePath(const char* path)
 	{
+		// Paths that have already been defined share the same id.
+		if (const auto found = _pathIds.Find(path))
+			return *found;
+
 		assert(_idCount < _ids.length);
+		_pathIds.Insert(path, _idCount);
 		auto& id = _ids[_idCount];
 		id.path = path;
 		return _idCount++;
 	}
 
-	void TextureStreamer::Update() const
+	void TextureStreamer::Update()
 	{
+		// Upload the textures that have been decoded.
+		uint32_t uploadCount = 0;
+		TextureDecodeResult result;
+		while (uploadCount < _uploadsPerFrame && _decoder->results.TryPop(result))
+		{
+			assert(result.pixels);
+			auto& id = _ids[result.id];
+
+			// The texture might have been freed, or already been uploaded by an earlier request.
+			if (id.state == Id::State::loading)
+			{
+				jv::ge::FillImage(id.resource->resource, result.pixels, &result.resolution);
+				id.state = Id::State::ready;
+				id.frameCount = static_cast<uint32_t>(result.resolution.x) / _frameWidth;
+				++uploadCount;
+
+				if (onTextureReady)
+					onTextureReady(result.id, userPtr);
+			}
+
+			stbi_image_free(result.pixels);
+		}
+
 		const uint32_t frameCount = jv::ge::GetFrameCount();
 
 		for (uint32_t i = 0; i < _idCount; ++i)
@@ -101,27 +170,94 @@ namespace game
 			{
 				id.resource->active = false;
 				id.resource = nullptr;
+				id.state = Id::State::unloaded;
 			}
 		}
 	}
 
 	TextureStreamer TextureStreamer::Create(jv::Arena& arena, const uint32_t poolChunkSize, const uint32_t idCount, 
-		const jv::ge::ImageCreateInfo& imageCreateInfo, const uint32_t frameWidth)
+		const jv::ge::ImageCreateInfo& imageCreateInfo, const uint32_t frameWidth, 
+		const uint32_t decodeThreadCount, const uint32_t uploadsPerFrame)
 	{
+		assert(decodeThreadCount > 0);
+		assert(uploadsPerFrame > 0);
+
 		TextureStreamer texturePool{};
 		texturePool._arena = &arena;
 		texturePool._scope = arena.CreateScope();
 		texturePool._imageCreateInfo = imageCreateInfo;
 		texturePool._ids = jv::CreateArray<Id>(arena, idCount);
+		texturePool._pathIds = jv::CreateHashMap<const char*, uint32_t>(arena, idCount * 2);
 		texturePool._poolChunkSize = poolChunkSize;
 		texturePool._frameWidth = frameWidth;
+		texturePool._uploadsPerFrame = uploadsPerFrame;
 		for (auto& id : texturePool._ids)
 			id = {};
+
+		// Evicted textures can be requested again while their old request is still being decoded.
+		uint32_t queueLength = 1;
+		while (queueLength < idCount * 2)
+			queueLength *= 2;
+
+		const auto decoder = texturePool._decoder = arena.New<TextureDecoder>();
+		decoder->requests = jv::CreateMPMCQueue<TextureDecodeRequest>(arena, queueLength);
+		decoder->results = jv::CreateMPMCQueue<TextureDecodeResult>(arena, queueLength);
+		decoder->threadCount = decodeThreadCount;
+		decoder->threads = static_cast<std::thread*>(arena.Alloc(sizeof(std::thread) * decodeThreadCount, alignof(std::thread)));
+		for (uint32_t i = 0; i < decodeThreadCount; ++i)
+			new(&decoder->threads[i]) std::thread(RunTextureDecoder, decoder);
 		return texturePool;
 	}
 
 	void TextureStreamer::Destroy(const TextureStreamer& pool)
 	{
+		const auto decoder = pool._decoder;
+		{
+			std::lock_guard<std::mutex> lock(decoder->mutex);
+			decoder->quit = true;
+		}
+		decoder->condition.notify_all();
+
+		for (uint32_t i = 0; i < decoder->threadCount; ++i)
+		{
+			decoder->threads[i].join();
+			decoder->threads[i].~thread();
+		}
+
+		TextureDecodeResult result;
+		while (decoder->results.TryPop(result))
+			stbi_image_free(result.pixels);
+		decoder->~TextureDecoder();
+
 		pool._arena->DestroyScope(pool._scope);
 	}
+
+	TextureStreamer::Resource* TextureStreamer::ClaimResource()
+	{
+		// Find a new resource to link it to.
+		for (auto& pool : _pools)
+			for (auto& resource : pool)
+				if (!resource.active)
+					return &resource;
+
+		// Make new resource if no available one exists.
+		Resource* resource = nullptr;
+		for (auto& pool : _pools)
+		{
+			if (pool.count != pool.length)
+			{
+				resource = &pool.Add();
+				break;
+			}
+		}
+		if (!resource)
+		{
+			auto& pool = Add(*_arena, _pools);
+			pool = jv::CreateVector<Resource>(*_arena, _poolChunkSize);
+			resource = &pool.Add();
+		}
+
+		resource->resource = AddImage(_imageCreateInfo);
+		return resource;
+	}
 }
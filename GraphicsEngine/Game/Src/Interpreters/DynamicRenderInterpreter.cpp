@@ -73,15 +73,17 @@ namespace game
 		_lightBufferSize = jv::ge::GetMinUniformOffset(sizeof(LightTask) * LIGHT_CAPACITY);
 
 		jv::ge::BufferCreateInfo lightInfoBufferCreateInfo{};
-		lightInfoBufferCreateInfo.size = _lightInfoSize * jv::ge::GetFrameCount();
+		lightInfoBufferCreateInfo.size = _lightInfoSize;
 		lightInfoBufferCreateInfo.scene = info.scene;
 		lightInfoBufferCreateInfo.type = jv::ge::BufferCreateInfo::Type::uniform;
+		lightInfoBufferCreateInfo.dynamic = true;
 		_lightInfoBuffer = AddBuffer(lightInfoBufferCreateInfo);
 
 		jv::ge::BufferCreateInfo lightsBufferCreateInfo{};
-		lightsBufferCreateInfo.size = _lightBufferSize * jv::ge::GetFrameCount();
+		lightsBufferCreateInfo.size = _lightBufferSize;
 		lightsBufferCreateInfo.scene = info.scene;
 		lightsBufferCreateInfo.type = jv::ge::BufferCreateInfo::Type::storage;
+		lightsBufferCreateInfo.dynamic = true;
 		_lightsBuffer = AddBuffer(lightsBufferCreateInfo);
 
 		for (uint32_t i = 0; i < frameCount; ++i)
@@ -91,14 +93,14 @@ namespace game
 			auto& uniformWriteBindingInfo = writeInfos[0];
 			uniformWriteBindingInfo.type = jv::ge::BindingType::uniformBuffer;
 			uniformWriteBindingInfo.buffer.buffer = _lightInfoBuffer;
-			uniformWriteBindingInfo.buffer.offset = _lightInfoSize * i;
+			uniformWriteBindingInfo.buffer.offset = jv::ge::GetBufferSlice(_lightInfoBuffer, i).offset;
 			uniformWriteBindingInfo.buffer.range = _lightInfoSize;
 			uniformWriteBindingInfo.index = 2;
 
 			auto& storageWriteBindingInfo = writeInfos[1];
 			storageWriteBindingInfo.type = jv::ge::BindingType::storageBuffer;
 			storageWriteBindingInfo.buffer.buffer = _lightsBuffer;
-			storageWriteBindingInfo.buffer.offset = _lightBufferSize * i;
+			storageWriteBindingInfo.buffer.offset = jv::ge::GetBufferSlice(_lightsBuffer, i).offset;
 			storageWriteBindingInfo.buffer.range = _lightBufferSize;
 			storageWriteBindingInfo.index = 3;
 
@@ -123,6 +125,8 @@ namespace game
 		const EngineMemory& memory)
 	{
 		_createInfo = createInfo;
+		DeclareRead(*createInfo.lightTasks);
+		DeclareGraphicsAccess();
 
 		const auto tempScope = memory.tempArena.CreateScope();
 		const auto vertCode = jv::file::Load(memory.tempArena, createInfo.vertPath);
@@ -180,25 +184,19 @@ namespace game
 		// Update lighting.
 		{
 			const auto& lightTasks = _createInfo.lightTasks->GetTaskBatches()[0];
-			LightInfo lightInfo{};
-			lightInfo.count = lightTasks.count;
-			lightInfo.ambient = glm::vec3(1);
 
-			jv::ge::BufferUpdateInfo bufferUpdateInfo{};
-			bufferUpdateInfo.buffer = _lightInfoBuffer;
-			bufferUpdateInfo.size = _lightInfoSize;
-			bufferUpdateInfo.offset = _lightInfoSize * frameIndex;
-			bufferUpdateInfo.data = &lightInfo; 
-			UpdateBuffer(bufferUpdateInfo);
+			const auto lightInfoSlice = jv::ge::GetBufferSlice(_lightInfoBuffer, frameIndex);
+			const auto lightInfo = static_cast<LightInfo*>(lightInfoSlice.data);
+			lightInfo->count = lightTasks.count;
+			lightInfo->ambient = glm::vec3(1);
+			jv::ge::FlushBufferSlice(_lightInfoBuffer, lightInfoSlice);
 
 			if(lightTasks.count > 0)
 			{
-				jv::ge::BufferUpdateInfo storageBufferUpdateInfo{};
-				storageBufferUpdateInfo.buffer = _lightsBuffer;
-				storageBufferUpdateInfo.size = _lightBufferSize;
-				storageBufferUpdateInfo.offset = _lightBufferSize * frameIndex;
-				storageBufferUpdateInfo.data = lightTasks.ptr;
-				UpdateBuffer(storageBufferUpdateInfo);
+				assert(lightTasks.count <= LIGHT_CAPACITY);
+				const auto lightsSlice = jv::ge::GetBufferSlice(_lightsBuffer, frameIndex);
+				memcpy(lightsSlice.data, lightTasks.ptr, sizeof(LightTask) * lightTasks.count);
+				jv::ge::FlushBufferSlice(_lightsBuffer, lightsSlice);
 			}
 		}
 
@@ -227,7 +225,7 @@ namespace game
 				writeInfo.bindingCount = 2;
 				Write(writeInfo);
 
-				PushConstant& pushConstant = *_createInfo.frameArena->New<PushConstant>();
+				PushConstant& pushConstant = *memory.frameArena.New<PushConstant>();
 				pushConstant.renderTask = task.renderTask;
 				pushConstant.camera = camera;
 				pushConstant.resolution = _createInfo.resolution;
@@ -9,6 +9,11 @@ namespace game
 		const EngineMemory& memory)
 	{
 		_createInfo = createInfo;
+		DeclareWrite(*createInfo.renderTasks);
+		DeclareWrite(*createInfo.priorityRenderTasks);
+		DeclareWrite(*createInfo.dynRenderTasks);
+		DeclareWrite(*createInfo.dynPriorityRenderTasks);
+		DeclareWrite(*createInfo.frontRenderTasks);
 	}
 
 	void PixelPerfectRenderInterpreter::OnUpdate(const EngineMemory& memory,
@@ -64,6 +64,7 @@ namespace game
 	void TextInterpreter::OnStart(const TextInterpreterCreateInfo& createInfo, const EngineMemory& memory)
 	{
 		_createInfo = createInfo;
+		DeclareWrite(*createInfo.renderTasks);
 	}
 
 	void TextInterpreter::OnUpdate(const EngineMemory& memory, const jv::LinkedList<jv::Vector<TextTask>>& tasks)
@@ -36,6 +36,11 @@ namespace game
 		canPause = true;
 	}
 
+	bool Level::CreateNext(const LevelCreateInfo& info)
+	{
+		return true;
+	}
+
 	bool Level::Update(const LevelUpdateInfo& info, LevelIndex& loadLevelIndex)
 	{
 		uint32_t pixelationSteps = 0;
@@ -258,7 +258,7 @@ namespace game
 			state.boardState.enemyCount = 0;
 		}
 		
-		const bool stackOverloaded = state.stack.count == state.stack.length;
+		const bool stackOverloaded = state.stack.count == STACK_MAX_SIZE;
 		if (stackOverloaded || comboCounter > STACK_OVERLOAD_THRESHOLD)
 		{
 			overloaded = true;
@@ -2111,12 +2111,17 @@ namespace game
 		states[3] = info.arena.New<RewardMagicCardState>();
 		states[4] = info.arena.New<RewardFlawCardState>();
 		states[5] = info.arena.New<RewardArtifactState>();
-		stateMachine = LevelStateMachine<State>::Create(info, states, State::Create(info));
+		stateMachine = LevelStateMachine<State>::CreateDeferred(states, State::Create(info));
 
 		//stateMachine.state.depth = 5;
 		//stateMachine.next = stateMachine.current;
 	}
 
+	bool MainLevel::CreateNext(const LevelCreateInfo& info)
+	{
+		return stateMachine.CreateNext(info);
+	}
+
 	bool MainLevel::Update(const LevelUpdateInfo& info, LevelIndex& loadLevelIndex)
 	{
 		if (!Level::Update(info, loadLevelIndex))
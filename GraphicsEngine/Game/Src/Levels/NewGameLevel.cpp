@@ -15,7 +15,12 @@ namespace game
 		const auto states = jv::CreateArray<LevelState<State>*>(info.arena, 2);
 		states[0] = info.arena.New<PartySelectState>();
 		states[1] = info.arena.New<JoinState>();
-		stateMachine = LevelStateMachine<State>::Create(info, states);
+		stateMachine = LevelStateMachine<State>::CreateDeferred(states);
+	}
+
+	bool NewGameLevel::CreateNext(const LevelCreateInfo& info)
+	{
+		return stateMachine.CreateNext(info);
 	}
 
 	bool NewGameLevel::Update(const LevelUpdateInfo& info, LevelIndex& loadLevelIndex)
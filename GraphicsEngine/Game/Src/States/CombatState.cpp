@@ -255,7 +255,7 @@ namespace game
 		state.paths = jv::CreateArray<Path>(info.arena, DISCOVER_LENGTH);
 		state.magicDeck = jv::CreateVector<uint32_t>(info.arena, SPELL_DECK_SIZE);
 		state.hand = jv::CreateVector<uint32_t>(info.arena, HAND_MAX_SIZE);
-		state.stack = jv::CreateVector<ActionState>(info.arena, STACK_MAX_SIZE);
+		state.arena = &info.arena;
 		state.mana = 0;
 		state.maxMana = 0;
 		return state;
@@ -263,7 +263,7 @@ namespace game
 
 	void State::TryAddToStack(const ActionState& actionState)
 	{
-		if(stack.count < stack.length)
-			stack.Add() = actionState;
+		if(stack.count < STACK_MAX_SIZE)
+			jv::Add(*arena, stack) = actionState;
 	}
 }
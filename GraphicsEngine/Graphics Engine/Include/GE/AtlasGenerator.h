@@ -12,8 +12,45 @@ namespace jv::ge
 		glm::ivec2 resolution;
 	};
 
+	// Time in milliseconds spent on each phase of the atlas generation.
+	struct AtlasGenerationTimings final
+	{
+		float decode = 0;
+		float pack = 0;
+		float blit = 0;
+		// Runs in the background, so it isn't part of the total.
+		float encode = 0;
+		// Time spent in GenerateAtlas.
+		float total = 0;
+	};
+
+	struct AtlasEncoder;
+
+	// Atlas of which the image is still being written to disk.
+	// If it goes out of scope before FinishAtlas is called, including during stack unwinding, it finishes itself.
+	struct GeneratedAtlas final
+	{
+		// RGBA pixels of the atlas, valid until the atlas is finished.
+		unsigned char* pixels = nullptr;
+		glm::ivec2 resolution{};
+		AtlasEncoder* encoder = nullptr;
+
+		GeneratedAtlas() = default;
+		GeneratedAtlas(GeneratedAtlas&& other) noexcept;
+		GeneratedAtlas(const GeneratedAtlas&) = delete;
+		GeneratedAtlas& operator=(const GeneratedAtlas&) = delete;
+		GeneratedAtlas& operator=(GeneratedAtlas&&) = delete;
+		~GeneratedAtlas();
+	};
+
 	// Generate a single texture from multiple smaller ones.
-	void GenerateAtlas(Arena& arena, Arena& tempArena, const Array<const char*>& filePaths, const char* imageFilePath, const char* metaFilePath);
+	// Images are decoded and blitted on threadCount threads, or on all available cores if it's 0.
+	// The meta data is written before returning, the image is encoded on its own thread until FinishAtlas is called.
+	// The pixels and the encoder live in tempArena, so the caller's scope has to outlive FinishAtlas.
+	[[nodiscard]] GeneratedAtlas GenerateAtlas(Arena& arena, Arena& tempArena, const Array<const char*>& filePaths,
+		const char* imageFilePath, const char* metaFilePath, uint32_t threadCount = 0);
+	// Waits until the atlas image has been written to disk.
+	void FinishAtlas(GeneratedAtlas& atlas, AtlasGenerationTimings* outTimings = nullptr);
 	// Load coordinates that correspond with a texture atlas.
 	[[nodiscard]] Array<AtlasTexture> LoadAtlasMetaData(Arena& arena, const char* metaFilePath);
 }
@@ -57,6 +57,14 @@ namespace jv::ge
 		const char* icon = nullptr;
 		glm::ivec2 resolution{ 800, 600 };
 		bool fullscreen = false;
+		// Tracks arena usage and prints a report on shutdown.
+		bool trackArenaStats = false;
+		// Amount of threads that can record draw batches at the same time.
+		uint32_t drawBatchThreadCount = 1;
+		// Amount of draw batches a single thread can record per frame.
+		uint32_t drawBatchCapacity = 16;
+		// Size of the host visible ring that image and mesh data is uploaded through.
+		size_t stagingRingSize = 16 * 1024 * 1024;
 
 		void (*onKeyCallback)(size_t key, size_t action) = nullptr;
 		void (*onMouseCallback)(size_t key, size_t action) = nullptr;
@@ -89,6 +97,8 @@ namespace jv::ge
 			storage
 		} type = Type::uniform;
 		uint32_t size;
+		// Gives every frame in flight its own slice of the given size, see GetBufferSlice.
+		bool dynamic = false;
 	};
 
 	struct DescriptorPoolCreateInfo final
@@ -207,6 +217,15 @@ namespace jv::ge
 		uint32_t offset = 0;
 	};
 
+	// Part of a dynamic buffer that belongs to a single frame in flight.
+	struct BufferSlice final
+	{
+		// Stays mapped for the lifetime of the buffer, so it can be written to directly.
+		void* data;
+		uint32_t offset;
+		uint32_t size;
+	};
+
 	struct DrawInfo final
 	{
 		Resource descriptorSets[4]{};
@@ -227,14 +246,58 @@ namespace jv::ge
 		Resource signalSemaphore = nullptr;
 	};
 
+	constexpr uint32_t MAX_MEMORY_HEAP_COUNT = 16;
+
+	struct MemoryHeapStats final
+	{
+		uint64_t size = 0;
+		// Memory allocated in the heap by this process. Without the budget extension, only the memory reserved by scenes is counted.
+		uint64_t usage = 0;
+		// Memory this process can allocate without affecting performance. Without the budget extension, this is the heap size.
+		uint64_t budget = 0;
+		// Memory reserved by the scenes.
+		uint64_t reserved = 0;
+		bool deviceLocal = false;
+	};
+
+	struct MemoryStats final
+	{
+		MemoryHeapStats heaps[MAX_MEMORY_HEAP_COUNT]{};
+		uint32_t heapCount = 0;
+		// Whether usage and budget are reported by the driver through VK_EXT_memory_budget.
+		bool budgetSupported = false;
+
+		void Print() const;
+	};
+
+	struct SceneMemoryStats final
+	{
+		// Device memory reserved by the scene, and the part of it that is allocated.
+		uint64_t reserved = 0;
+		uint64_t used = 0;
+		uint64_t imageMemory = 0;
+		uint64_t meshMemory = 0;
+		uint64_t bufferMemory = 0;
+		uint32_t imageCount = 0;
+		uint32_t meshCount = 0;
+		uint32_t bufferCount = 0;
+		uint32_t samplerCount = 0;
+		uint32_t poolCount = 0;
+
+		void Print() const;
+	};
+
 	void Initialize(const CreateInfo& info);
 	[[nodiscard]] glm::ivec2 GetResolution();
 	[[nodiscard]] glm::ivec2 GetMonitorResolution();
 	[[nodiscard]] glm::vec2 GetMousePosition();
 	void Resize(glm::ivec2 resolution, bool fullScreen);
 	[[nodiscard]] Resource CreateScene();
-	void ClearScene(Resource scene);
+	// Destroys the resources of the scene. Keeping its memory avoids reallocating it when the scene is filled again.
+	void ClearScene(Resource scene, bool keepMemory = false);
 	[[nodiscard]] Resource AddImage(const ImageCreateInfo& info);
+	// Image and mesh uploads are batched and submitted by the next RenderFrame or FlushUploads call.
+	// They run on the transfer queue when the device has one. Images that are filled again must not be in use by frames in flight.
 	void FillImage(Resource image, unsigned char* pixels, glm::ivec2* overrideResolution = nullptr);
 	[[nodiscard]] Resource AddMesh(MeshCreateInfo& info);
 	[[nodiscard]] Resource AddBuffer(const BufferCreateInfo& info);
@@ -243,6 +306,10 @@ namespace jv::ge
 	[[nodiscard]] Resource GetDescriptorSet(Resource pool, uint32_t index);
 	void Write(const WriteInfo& info);
 	void UpdateBuffer(const BufferUpdateInfo& info);
+	// Returns the slice of a dynamic buffer that the frame with the given index reads from.
+	[[nodiscard]] BufferSlice GetBufferSlice(Resource buffer, uint32_t frameIndex);
+	// Makes the writes to a slice visible to the GPU. Does nothing when the buffer's memory is host coherent.
+	void FlushBufferSlice(Resource buffer, const BufferSlice& slice);
 	[[nodiscard]] Resource CreateShader(const ShaderCreateInfo& info);
 	[[nodiscard]] Resource CreateLayout(const LayoutCreateInfo& info);
 	[[nodiscard]] Resource CreateRenderPass(const RenderPassCreateInfo& info);
@@ -250,11 +317,30 @@ namespace jv::ge
 	[[nodiscard]] Resource CreateSemaphore();
 	[[nodiscard]] Resource CreatePipeline(const PipelineCreateInfo& info);
 	void Draw(const DrawInfo& info);
-	[[nodiscard]] bool WaitForImage();
+	// Records the draw calls made on this thread into a secondary command buffer, until EndDrawBatch is called.
+	// Threads with different thread indices can record batches at the same time.
+	// The next RenderFrame that renders with the batch's render pass executes it, batches are executed in ascending order.
+	// Draws that weren't batched are executed after them.
+	void BeginDrawBatch(uint32_t threadIndex, uint32_t order);
+	void EndDrawBatch();
+	// Sets the thread index that RenderFrame records the draws that weren't batched with, when it's called from this thread.
+	// Defaults to 0. Threads that render while another thread records batches need an index of their own.
+	void SetRenderFrameThreadIndex(uint32_t threadIndex);
+	// Polls window events. Returns false when the window should close. Only call this from the main thread.
+	[[nodiscard]] bool PollEvents();
+	// Waits until the next swap chain image is available. When not polling events, this can be called from any thread.
+	[[nodiscard]] bool WaitForImage(bool pollEvents = true);
+	// Submits the pending image and mesh uploads without waiting for them. Flushing early lets them overlap with the previous frame.
+	void FlushUploads();
 	[[nodiscard]] bool RenderFrame(const RenderFrameInfo& info);
 	[[nodiscard]] uint32_t GetFrameCount();
 	[[nodiscard]] uint32_t GetFrameIndex();
 	[[nodiscard]] uint32_t GetMinUniformOffset(size_t s);
 	void DeviceWaitIdle();
+	// Cheap enough to query every frame, for instance to keep streaming within the budget.
+	[[nodiscard]] MemoryStats GetMemoryStats();
+	[[nodiscard]] SceneMemoryStats GetSceneMemoryStats(Resource scene);
+	// Prints the heap stats, followed by the stats of every scene.
+	void PrintMemoryStats();
 	void Shutdown();
 }
@@ -3,19 +3,41 @@
 
 namespace jv
 {
+	constexpr uint32_t CACHE_LINE_SIZE = 64;
+
 	struct Arena;
 
+	// Usage statistics of an arena. Only tracked when passed to the arena on creation.
+	struct ArenaStats final
+	{
+		const char* name = "Arena";
+		uint32_t usedBytes = 0;
+		uint32_t peakBytes = 0;
+		uint32_t framePeakBytes = 0;
+		uint32_t lastFramePeakBytes = 0;
+		uint32_t overflowChunkCount = 0;
+		uint32_t scopeCount = 0;
+		uint32_t lastScopeReclaimedBytes = 0;
+		uint64_t scopeReclaimedBytes = 0;
+
+		// Stores the peak of the frame that just ended and starts tracking the next one.
+		void EndFrame();
+		void Print() const;
+	};
+
 	struct ArenaCreateInfo final
 	{
 		void* (*alloc)(uint32_t size);
 		void (*free)(void* ptr);
 		void* memory = nullptr;
 		uint32_t memorySize = 4096;
+		ArenaStats* stats = nullptr;
 	};
 
 	struct ArenaAllocMetaData final
 	{
 		uint32_t size;
+		uint32_t padding;
 	};
 
 	// Handles manual memory allocation.
@@ -41,17 +63,26 @@ namespace jv
 		void* memory;
 		uint32_t front = 0;
 		Arena* next = nullptr;
+		// Chunk that is currently allocated from. Null when this is the root chunk itself.
+		Arena* tail = nullptr;
+		uint32_t tailDepth = 0;
 
 		[[nodiscard]] static Arena Create(const ArenaCreateInfo& info);
 		static void Destroy(const Arena& arena);
 
-		void* Alloc(uint32_t size);
+		// Alignment must be a power of two.
+		void* Alloc(uint32_t size, uint32_t alignment = sizeof(uint32_t));
 		void Free(const void* ptr);
+		// Resizes an allocation in place. Only possible if it is the most recent allocation and the chunk has room.
+		[[nodiscard]] bool TryResize(const void* ptr, uint32_t size);
 		void Clear();
-		[[nodiscard] ]uint32_t GetTotalUsedMemory() const;
+		// Clears the arena and frees all overflow chunks, leaving only the root chunk.
+		void Reset();
+		// Returns the amount of bytes in use over all chunks.
+		[[nodiscard]] uint32_t GetTotalUsedMemory() const;
 
 		template <typename T>
-		[[nodiscard]] T* New(size_t count = 1);
+		[[nodiscard]] T* New(size_t count = 1, uint32_t alignment = alignof(T));
 
 		// A scope can be used to instantly delete everything that was made after the scope's creation.
 		[[nodiscard]] uint64_t CreateScope() const;
@@ -59,9 +90,9 @@ namespace jv
 	};
 
 	template <typename T>
-	T* Arena::New(const size_t count)
+	T* Arena::New(const size_t count, const uint32_t alignment)
 	{
-		void* ptr = Alloc(sizeof(T) * count);
+		void* ptr = Alloc(static_cast<uint32_t>(sizeof(T) * count), alignment);
 		T* ptrType = static_cast<T*>(ptr);
 		for (uint32_t i = 0; i < count; ++i)
 			new(&ptrType[i]) T();
@@ -0,0 +1,33 @@
+﻿#pragma once
+#include <atomic>
+
+namespace jv
+{
+	struct ChunkPoolCreateInfo final
+	{
+		void* (*alloc)(uint32_t size);
+		void (*free)(void* ptr);
+		uint32_t chunkSize = 4096;
+		uint32_t chunkCount = 32;
+	};
+
+	// Thread safe pool of fixed size memory chunks, used to refill arenas that live on different threads.
+	// Alloc and Free are lock-free. Requests larger than a chunk, or made while the pool is empty, fall back to the alloc callback.
+	struct ChunkPool final
+	{
+		ChunkPoolCreateInfo info;
+		char* memory;
+		// Index of the next free chunk for every chunk.
+		std::atomic<uint32_t>* next;
+		// Index of the first free chunk in the lower half, ABA tag in the upper half.
+		std::atomic<uint64_t>* head;
+
+		// The free list is allocated from the given arena, the chunks themselves from the alloc callback.
+		[[nodiscard]] static ChunkPool Create(Arena& arena, const ChunkPoolCreateInfo& info);
+		static void Destroy(const ChunkPool& chunkPool);
+
+		[[nodiscard]] void* Alloc(uint32_t size) const;
+		void Free(void* ptr) const;
+		[[nodiscard]] bool Owns(const void* ptr) const;
+	};
+}
@@ -0,0 +1,158 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+namespace jv
+{
+	// Queue position that lives on its own cache line, so producers and consumers do not invalidate each other's counters.
+	struct alignas(CACHE_LINE_SIZE) ConcurrentQueueCounter final
+	{
+		std::atomic<uint32_t> value{ 0 };
+		// Last observed value of the opposite counter. Only touched by the thread that owns this counter.
+		uint32_t cached = 0;
+	};
+
+	// Lock-free First In First Out queue for exactly one producer thread and one consumer thread.
+	// Length has to be a power of two.
+	template <typename T>
+	struct SPSCQueue final
+	{
+		T* ptr = nullptr;
+		uint32_t length = 0;
+		// Written by the consumer.
+		ConcurrentQueueCounter* head = nullptr;
+		// Written by the producer.
+		ConcurrentQueueCounter* tail = nullptr;
+
+		// Can only be called from the producer thread. Returns false if the queue is full.
+		[[nodiscard]] bool TryAdd(const T& value) const;
+		// Can only be called from the consumer thread. Returns false if the queue is empty.
+		[[nodiscard]] bool TryPop(T& out) const;
+		// Approximation when called while other threads are using the queue.
+		[[nodiscard]] uint32_t GetCount() const;
+	};
+
+	// Bounded lock-free First In First Out queue for any number of producer and consumer threads.
+	// Every cell has a sequence number that tells whether it is ready to be written to or read from.
+	// Length has to be a power of two.
+	template <typename T>
+	struct MPMCQueue final
+	{
+		struct Cell final
+		{
+			std::atomic<uint32_t> sequence{ 0 };
+			T value{};
+		};
+
+		Cell* cells = nullptr;
+		uint32_t length = 0;
+		ConcurrentQueueCounter* head = nullptr;
+		ConcurrentQueueCounter* tail = nullptr;
+
+		// Returns false if the queue is full.
+		[[nodiscard]] bool TryAdd(const T& value) const;
+		// Returns false if the queue is empty.
+		[[nodiscard]] bool TryPop(T& out) const;
+		// Approximation when called while other threads are using the queue.
+		[[nodiscard]] uint32_t GetCount() const;
+	};
+
+	template <typename T>
+	bool SPSCQueue<T>::TryAdd(const T& value) const
+	{
+		const uint32_t position = tail->value.load(std::memory_order_relaxed);
+		if (position - tail->cached == length)
+		{
+			tail->cached = head->value.load(std::memory_order_acquire);
+			if (position - tail->cached == length)
+				return false;
+		}
+
+		ptr[position & (length - 1)] = value;
+		tail->value.store(position + 1, std::memory_order_release);
+		return true;
+	}
+
+	template <typename T>
+	bool SPSCQueue<T>::TryPop(T& out) const
+	{
+		const uint32_t position = head->value.load(std::memory_order_relaxed);
+		if (position == head->cached)
+		{
+			head->cached = tail->value.load(std::memory_order_acquire);
+			if (position == head->cached)
+				return false;
+		}
+
+		out = ptr[position & (length - 1)];
+		head->value.store(position + 1, std::memory_order_release);
+		return true;
+	}
+
+	template <typename T>
+	uint32_t SPSCQueue<T>::GetCount() const
+	{
+		return tail->value.load(std::memory_order_acquire) - head->value.load(std::memory_order_acquire);
+	}
+
+	template <typename T>
+	bool MPMCQueue<T>::TryAdd(const T& value) const
+	{
+		uint32_t position = tail->value.load(std::memory_order_relaxed);
+		while (true)
+		{
+			Cell& cell = cells[position & (length - 1)];
+			const uint32_t sequence = cell.sequence.load(std::memory_order_acquire);
+			const auto diff = static_cast<int32_t>(sequence - position);
+
+			if (diff == 0)
+			{
+				if (tail->value.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+				{
+					cell.value = value;
+					cell.sequence.store(position + 1, std::memory_order_release);
+					return true;
+				}
+			}
+			// The cell still holds a value from the previous lap.
+			else if (diff < 0)
+				return false;
+			else
+				position = tail->value.load(std::memory_order_relaxed);
+		}
+	}
+
+	template <typename T>
+	bool MPMCQueue<T>::TryPop(T& out) const
+	{
+		uint32_t position = head->value.load(std::memory_order_relaxed);
+		while (true)
+		{
+			Cell& cell = cells[position & (length - 1)];
+			const uint32_t sequence = cell.sequence.load(std::memory_order_acquire);
+			const auto diff = static_cast<int32_t>(sequence - (position + 1));
+
+			if (diff == 0)
+			{
+				if (head->value.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+				{
+					out = cell.value;
+					cell.sequence.store(position + length, std::memory_order_release);
+					return true;
+				}
+			}
+			// Nothing has been written to the cell yet.
+			else if (diff < 0)
+				return false;
+			else
+				position = head->value.load(std::memory_order_relaxed);
+		}
+	}
+
+	template <typename T>
+	uint32_t MPMCQueue<T>::GetCount() const
+	{
+		const uint32_t count = tail->value.load(std::memory_order_acquire) - head->value.load(std::memory_order_acquire);
+		return count > length ? 0 : count;
+	}
+}
@@ -0,0 +1,198 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace jv
+{
+	// Default hash for hash maps. Integers, enums and pointers are mixed, C strings are hashed by their contents
+	// and other types by their bytes.
+	template <typename T>
+	struct Hash final
+	{
+		[[nodiscard]] uint32_t operator()(const T& key) const;
+	};
+
+	// Default key comparison for hash maps. C strings are compared by their contents.
+	template <typename T>
+	struct Equal final
+	{
+		[[nodiscard]] bool operator()(const T& a, const T& b) const;
+	};
+
+	// Nonlinear data container used for fast lookup (O(1)).
+	// Uses linear probing in a power of two sized table, erasing shifts the following entries back instead of leaving tombstones.
+	template <typename Key, typename Value, typename Hasher = Hash<Key>, typename Comparer = Equal<Key>>
+	struct HashMap final
+	{
+		struct Slot final
+		{
+			Key key{};
+			Value value{};
+			bool occupied = false;
+		};
+
+		Slot* slots = nullptr;
+		uint32_t capacity = 0;
+		uint32_t count = 0;
+		Hasher hasher{};
+		Comparer comparer{};
+
+		// Inserts a value, or overwrites it if the key is already present.
+		Value& Insert(const Key& key, const Value& value);
+		[[nodiscard]] Value* Find(const Key& key) const;
+		[[nodiscard]] bool Contains(const Key& key) const;
+		bool Erase(const Key& key);
+		void Clear();
+		[[nodiscard]] bool IsFull() const;
+
+	private:
+		[[nodiscard]] uint32_t GetIndex(const Key& key) const;
+	};
+
+	inline uint32_t HashBytes(const void* data, const size_t size)
+	{
+		// FNV-1a.
+		uint32_t hash = 2166136261u;
+		const auto bytes = static_cast<const uint8_t*>(data);
+		for (size_t i = 0; i < size; ++i)
+		{
+			hash ^= bytes[i];
+			hash *= 16777619u;
+		}
+		return hash;
+	}
+
+	inline uint32_t HashInteger(uint64_t key)
+	{
+		// Murmur3 finalizer.
+		key ^= key >> 33;
+		key *= 0xff51afd7ed558ccdull;
+		key ^= key >> 33;
+		key *= 0xc4ceb9fe1a85ec53ull;
+		key ^= key >> 33;
+		return static_cast<uint32_t>(key);
+	}
+
+	template <typename T>
+	uint32_t Hash<T>::operator()(const T& key) const
+	{
+		if constexpr (std::is_same_v<T, const char*> || std::is_same_v<T, char*>)
+			return HashBytes(key, strlen(key));
+		else if constexpr (std::is_pointer_v<T>)
+			return HashInteger(reinterpret_cast<uintptr_t>(key));
+		else if constexpr (std::is_integral_v<T> || std::is_enum_v<T>)
+			return HashInteger(static_cast<uint64_t>(key));
+		else
+			return HashBytes(&key, sizeof(T));
+	}
+
+	template <typename T>
+	bool Equal<T>::operator()(const T& a, const T& b) const
+	{
+		if constexpr (std::is_same_v<T, const char*> || std::is_same_v<T, char*>)
+			return strcmp(a, b) == 0;
+		else
+			return a == b;
+	}
+
+	template <typename Key, typename Value, typename Hasher, typename Comparer>
+	Value& HashMap<Key, Value, Hasher, Comparer>::Insert(const Key& key, const Value& value)
+	{
+		assert(capacity > 0);
+		const uint32_t mask = capacity - 1;
+
+		uint32_t index = hasher(key) & mask;
+		while (slots[index].occupied)
+		{
+			if (comparer(slots[index].key, key))
+				return slots[index].value = value;
+			index = (index + 1) & mask;
+		}
+
+		assert(!IsFull());
+		auto& slot = slots[index];
+		slot.key = key;
+		slot.value = value;
+		slot.occupied = true;
+		++count;
+		return slot.value;
+	}
+
+	template <typename Key, typename Value, typename Hasher, typename Comparer>
+	Value* HashMap<Key, Value, Hasher, Comparer>::Find(const Key& key) const
+	{
+		const uint32_t index = GetIndex(key);
+		return index == UINT32_MAX ? nullptr : &slots[index].value;
+	}
+
+	template <typename Key, typename Value, typename Hasher, typename Comparer>
+	bool HashMap<Key, Value, Hasher, Comparer>::Contains(const Key& key) const
+	{
+		return GetIndex(key) != UINT32_MAX;
+	}
+
+	template <typename Key, typename Value, typename Hasher, typename Comparer>
+	bool HashMap<Key, Value, Hasher, Comparer>::Erase(const Key& key)
+	{
+		uint32_t index = GetIndex(key);
+		if (index == UINT32_MAX)
+			return false;
+
+		const uint32_t mask = capacity - 1;
+		uint32_t next = index;
+
+		// Shift back every following entry that would otherwise no longer be reachable from its ideal slot.
+		while (true)
+		{
+			next = (next + 1) & mask;
+			auto& slot = slots[next];
+			if (!slot.occupied)
+				break;
+
+			const uint32_t ideal = hasher(slot.key) & mask;
+			const bool inRange = index <= next ? index < ideal && ideal <= next : index < ideal || ideal <= next;
+			if (inRange)
+				continue;
+
+			slots[index] = slot;
+			index = next;
+		}
+
+		slots[index] = {};
+		--count;
+		return true;
+	}
+
+	template <typename Key, typename Value, typename Hasher, typename Comparer>
+	void HashMap<Key, Value, Hasher, Comparer>::Clear()
+	{
+		for (uint32_t i = 0; i < capacity; ++i)
+			slots[i] = {};
+		count = 0;
+	}
+
+	template <typename Key, typename Value, typename Hasher, typename Comparer>
+	bool HashMap<Key, Value, Hasher, Comparer>::IsFull() const
+	{
+		// Keep the load factor under 3/4 so probe sequences stay short and always end on an empty slot.
+		return (count + 1) * 4 > capacity * 3;
+	}
+
+	template <typename Key, typename Value, typename Hasher, typename Comparer>
+	uint32_t HashMap<Key, Value, Hasher, Comparer>::GetIndex(const Key& key) const
+	{
+		if (count == 0)
+			return UINT32_MAX;
+
+		const uint32_t mask = capacity - 1;
+		uint32_t index = hasher(key) & mask;
+		while (slots[index].occupied)
+		{
+			if (comparer(slots[index].key, key))
+				return index;
+			index = (index + 1) & mask;
+		}
+		return UINT32_MAX;
+	}
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include "HashMap.h"
+
+namespace jv
+{
+	template <typename Key, typename Value, typename Hasher = Hash<Key>, typename Comparer = Equal<Key>>
+	HashMap<Key, Value, Hasher, Comparer> CreateHashMap(Arena& arena, const uint32_t capacity)
+	{
+		// Round up to a power of two so the hash can be masked.
+		uint32_t powCapacity = 8;
+		while (powCapacity < capacity)
+			powCapacity *= 2;
+
+		HashMap<Key, Value, Hasher, Comparer> map{};
+		map.slots = arena.New<typename HashMap<Key, Value, Hasher, Comparer>::Slot>(powCapacity);
+		map.capacity = powCapacity;
+		return map;
+	}
+
+	// Moves all entries to a new table with the given capacity.
+	template <typename Key, typename Value, typename Hasher, typename Comparer>
+	void Rehash(Arena& arena, HashMap<Key, Value, Hasher, Comparer>& map, const uint32_t capacity)
+	{
+		auto other = CreateHashMap<Key, Value, Hasher, Comparer>(arena, capacity);
+		other.hasher = map.hasher;
+		other.comparer = map.comparer;
+		assert(map.count * 4 < other.capacity * 3);
+
+		for (uint32_t i = 0; i < map.capacity; ++i)
+		{
+			const auto& slot = map.slots[i];
+			if (slot.occupied)
+				other.Insert(slot.key, slot.value);
+		}
+		map = other;
+	}
+
+	// Inserts a value, doubling the capacity of the map when it's about to exceed its maximum load.
+	template <typename Key, typename Value, typename Hasher, typename Comparer>
+	Value& Insert(Arena& arena, HashMap<Key, Value, Hasher, Comparer>& map, const Key& key, const Value& value)
+	{
+		if (map.IsFull())
+		{
+			if (const auto found = map.Find(key))
+				return *found = value;
+			Rehash(arena, map, map.capacity * 2);
+		}
+		return map.Insert(key, value);
+	}
+
+	template <typename Key, typename Value, typename Hasher, typename Comparer>
+	void DestroyHashMap(Arena& arena, const HashMap<Key, Value, Hasher, Comparer>& map)
+	{
+		arena.Free(map.slots);
+	}
+}
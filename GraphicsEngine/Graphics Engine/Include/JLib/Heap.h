@@ -1,106 +1,226 @@
 #pragma once
-#include "KeyPair.h"
 #include <cstdint>
 
 namespace jv
 {
-	// A nonlinear data container that automatically sorts values added.
+	// A nonlinear data container that automatically sorts values added, lowest key first.
+	// Implemented as an iterative 4-ary heap. Values can be reprioritized through the stable handle returned on insertion.
 	template <typename T>
 	struct Heap final
 	{
-		KeyPair<T>* data = nullptr;
+		struct Node final
+		{
+			T value{};
+			uint32_t key = 0;
+			uint32_t handle = 0;
+		};
+
+		Node* data = nullptr;
+		// Index in data for every handle.
+		uint32_t* indices = nullptr;
 		uint32_t length = 0;
 		uint32_t count = 0;
 
-		void Insert(const T& value, uint32_t key);
-		[[nodiscard]] T Peek();
+		uint32_t Insert(const T& value, uint32_t key);
+		[[nodiscard]] T Peek() const;
+		[[nodiscard]] uint32_t PeekKey() const;
 		T Pop();
+		// Changes the key of the value with the given handle, moving it up or down the heap.
+		void Update(uint32_t handle, uint32_t key);
+		void DecreaseKey(uint32_t handle, uint32_t key);
+		void Remove(uint32_t handle);
+		[[nodiscard]] T& Get(uint32_t handle) const;
+		// Replaces the contents of the heap in O(n). The handle of each value is equal to its index.
+		void Heapify(const T* values, const uint32_t* keys, uint32_t valueCount);
 		void Clear();
 
 	private:
-		void HeapifyBottomToTop(uint32_t index);
-		void HeapifyTopToBottom(uint32_t index);
+		static constexpr uint32_t ARITY = 4;
+
+		void Place(const Node& node, uint32_t index);
+		void SiftUp(uint32_t index);
+		void SiftDown(uint32_t index);
+		void RemoveAt(uint32_t index);
 	};
 
 	template <typename T>
-	void Heap<T>::Insert(const T& value, const uint32_t key)
+	uint32_t Heap<T>::Insert(const T& value, const uint32_t key)
 	{
 		assert(count < length);
-		count++;
 
-		auto& keyPair = data[count];
-		keyPair.key = key;
-		keyPair.value = value;
-		HeapifyBottomToTop(count);
+		// Unused nodes keep the handles that are not in use.
+		auto& node = data[count];
+		const uint32_t handle = node.handle;
+		node.value = value;
+		node.key = key;
+		indices[handle] = count;
+		SiftUp(count++);
+		return handle;
 	}
 
 	template <typename T>
-	T Heap<T>::Peek()
+	T Heap<T>::Peek() const
 	{
 		assert(count > 0);
-		const T value = data[1].value;
-		return value;
+		return data[0].value;
+	}
+
+	template <typename T>
+	uint32_t Heap<T>::PeekKey() const
+	{
+		assert(count > 0);
+		return data[0].key;
 	}
 
 	template <typename T>
 	T Heap<T>::Pop()
 	{
 		assert(count > 0);
+		const T value = data[0].value;
+		RemoveAt(0);
+		return value;
+	}
+
+	template <typename T>
+	void Heap<T>::Update(const uint32_t handle, const uint32_t key)
+	{
+		assert(handle < length);
+		const uint32_t index = indices[handle];
+		assert(index < count);
+
+		const uint32_t oldKey = data[index].key;
+		data[index].key = key;
+		if (key < oldKey)
+			SiftUp(index);
+		else
+			SiftDown(index);
+	}
 
-		const T value = data[1].value;
-		data[1] = data[count--];
+	template <typename T>
+	void Heap<T>::DecreaseKey(const uint32_t handle, const uint32_t key)
+	{
+		assert(handle < length);
+		const uint32_t index = indices[handle];
+		assert(index < count);
+		assert(key <= data[index].key);
 
-		HeapifyTopToBottom(1);
-		return value;
+		data[index].key = key;
+		SiftUp(index);
 	}
 
 	template <typename T>
-	void Heap<T>::Clear()
+	void Heap<T>::Remove(const uint32_t handle)
 	{
-		count = 0;
+		assert(handle < length);
+		const uint32_t index = indices[handle];
+		assert(index < count);
+		RemoveAt(index);
 	}
 
 	template <typename T>
-	void Heap<T>::HeapifyBottomToTop(const uint32_t index)
+	T& Heap<T>::Get(const uint32_t handle) const
 	{
-		// Tree root found.
-		if (index <= 1)
-			return;
+		assert(handle < length);
+		const uint32_t index = indices[handle];
+		assert(index < count);
+		return data[index].value;
+	}
 
-		uint32_t parentIndex = index / 2;
+	template <typename T>
+	void Heap<T>::Heapify(const T* values, const uint32_t* keys, const uint32_t valueCount)
+	{
+		assert(valueCount <= length);
 
-		// If current is smaller than the parent, swap and continue.
-		if (data[index].key < data[parentIndex].key)
+		for (uint32_t i = 0; i < length; ++i)
 		{
-			auto keyPair = data[index];
-			data[index] = data[parentIndex];
-			data[parentIndex] = keyPair;
-			HeapifyBottomToTop(parentIndex);
+			auto& node = data[i];
+			node.handle = i;
+			indices[i] = i;
+			if (i < valueCount)
+			{
+				node.value = values[i];
+				node.key = keys[i];
+			}
 		}
+
+		count = valueCount;
+		if (count < 2)
+			return;
+
+		// Sift down every node that has children, starting with the last parent.
+		uint32_t i = (count - 2) / ARITY + 1;
+		while (i-- > 0)
+			SiftDown(i);
 	}
 
 	template <typename T>
-	void Heap<T>::HeapifyTopToBottom(const uint32_t index)
+	void Heap<T>::Clear()
 	{
-		const uint32_t left = index * 2;
-		const uint32_t right = index * 2 + 1;
+		count = 0;
+	}
 
-		// If no more nodes remain on the left side.
-		if (count < left)
-			return;
+	template <typename T>
+	void Heap<T>::Place(const Node& node, const uint32_t index)
+	{
+		data[index] = node;
+		indices[node.handle] = index;
+	}
 
-		// Is the left node smaller than index.
-		const bool lDiff = data[index].key > data[left].key;
-		// Is the right node smaller than index.
-		const bool rDiff = count > left ? data[index].key > data[right].key : false;
-		// Is left smaller than right.
-		const bool dir = rDiff ? data[left].key > data[right].key : false;
+	template <typename T>
+	void Heap<T>::SiftUp(uint32_t index)
+	{
+		const Node node = data[index];
+		while (index > 0)
+		{
+			const uint32_t parent = (index - 1) / ARITY;
+			if (data[parent].key <= node.key)
+				break;
+			Place(data[parent], index);
+			index = parent;
+		}
+		Place(node, index);
+	}
 
-		if (lDiff || rDiff)
+	template <typename T>
+	void Heap<T>::SiftDown(uint32_t index)
+	{
+		const Node node = data[index];
+		while (true)
 		{
-			const uint32_t newIndex = left + dir;
-			Swap(data, newIndex, index);
-			HeapifyTopToBottom(newIndex);
+			const uint32_t first = index * ARITY + 1;
+			if (first >= count)
+				break;
+
+			// Find the child with the lowest key.
+			const uint32_t last = first + ARITY < count ? first + ARITY : count;
+			uint32_t lowest = first;
+			for (uint32_t child = first + 1; child < last; ++child)
+				if (data[child].key < data[lowest].key)
+					lowest = child;
+
+			if (node.key <= data[lowest].key)
+				break;
+			Place(data[lowest], index);
+			index = lowest;
+		}
+		Place(node, index);
+	}
+
+	template <typename T>
+	void Heap<T>::RemoveAt(const uint32_t index)
+	{
+		// Swap with the last node so that the removed handle stays available for reuse.
+		const Node removed = data[index];
+		const uint32_t last = --count;
+		if (index != last)
+		{
+			Place(data[last], index);
+			Place(removed, last);
+
+			if (index > 0 && data[index].key < data[(index - 1) / ARITY].key)
+				SiftUp(index);
+			else
+				SiftDown(index);
 		}
 	}
 }
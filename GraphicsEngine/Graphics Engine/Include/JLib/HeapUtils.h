@@ -7,14 +7,21 @@ namespace jv
 	Heap<T> CreateHeap(Arena& arena, const uint32_t length)
 	{
 		Heap<T> instance{};
-		instance.data = arena.New<KeyPair<T>>(length + 1);
+		instance.data = arena.New<typename Heap<T>::Node>(length);
+		instance.indices = arena.New<uint32_t>(length);
 		instance.length = length;
+		for (uint32_t i = 0; i < length; ++i)
+		{
+			instance.data[i].handle = i;
+			instance.indices[i] = i;
+		}
 		return instance;
 	}
 
 	template <typename T>
 	void DestroyHeap(Heap<T>& instance, Arena& arena)
 	{
+		arena.Free(instance.indices);
 		arena.Free(instance.data);
 	}
 }
@@ -2,6 +2,7 @@
 #include "ArrayUtils.h"
 #include "LinkedList.h"
 #include "Arena.h"
+#include "Pool.h"
 
 namespace jv
 {
@@ -64,6 +65,51 @@ namespace jv
 		return t;
 	}
 
+	template <typename T>
+	T& Add(Pool<LinkedListNode<T>>& pool, LinkedList<T>& linkedList)
+	{
+		auto n = pool.New();
+		n->next = linkedList.values;
+		linkedList.values = n;
+		return n->value;
+	}
+
+	template <typename T>
+	T Pop(Pool<LinkedListNode<T>>& pool, LinkedList<T>& linkedList)
+	{
+		assert(linkedList.values);
+
+		LinkedListNode<T>* n = linkedList.values;
+		T t = n->value;
+		linkedList.values = n->next;
+		pool.Free(n);
+		return t;
+	}
+
+	// Unlinks the node at the given index, where index 0 is the most recently added value.
+	template <typename T>
+	void Erase(Pool<LinkedListNode<T>>& pool, LinkedList<T>& linkedList, const uint32_t index)
+	{
+		LinkedListNode<T>** n = &linkedList.values;
+		for (uint32_t i = 0; i < index; ++i)
+		{
+			assert(*n);
+			n = &(*n)->next;
+		}
+
+		assert(*n);
+		LinkedListNode<T>* erased = *n;
+		*n = erased->next;
+		pool.Free(erased);
+	}
+
+	template <typename T>
+	void DestroyLinkedList(Pool<LinkedListNode<T>>& pool, LinkedList<T>& linkedList)
+	{
+		while (linkedList.values)
+			Pop(pool, linkedList);
+	}
+
 	template <typename T>
 	void DestroyLinkedList(Arena& arena, const LinkedList<T>& linkedList)
 	{
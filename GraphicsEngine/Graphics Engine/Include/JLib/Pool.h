@@ -0,0 +1,67 @@
+#pragma once
+#include <cstdint>
+
+namespace jv
+{
+	// Fixed size object allocator with O(1) allocation and deallocation.
+	// Objects are stored in cache line aligned slabs that are taken from an arena, freed objects are reused before the slabs grow.
+	template <typename T>
+	struct Pool final
+	{
+		struct alignas(alignof(T) > alignof(void*) ? alignof(T) : alignof(void*)) Slot final
+		{
+			char data[sizeof(T) > sizeof(void*) ? sizeof(T) : sizeof(void*)];
+		};
+
+		Arena* arena = nullptr;
+		uint32_t slabLength = 0;
+		Slot* slab = nullptr;
+		uint32_t slabCount = 0;
+		Slot* freeList = nullptr;
+
+		[[nodiscard]] T* New();
+		void Free(T* ptr);
+		// Forgets all slabs, used when the arena memory has been cleared.
+		void Clear();
+	};
+
+	template <typename T>
+	T* Pool<T>::New()
+	{
+		assert(arena);
+
+		Slot* slot = freeList;
+		if (slot)
+			freeList = *reinterpret_cast<Slot**>(slot);
+		else
+		{
+			if (!slab || slabCount == slabLength)
+			{
+				constexpr uint32_t alignment = alignof(Slot) > CACHE_LINE_SIZE ? alignof(Slot) : CACHE_LINE_SIZE;
+				slab = static_cast<Slot*>(arena->Alloc(sizeof(Slot) * slabLength, alignment));
+				slabCount = 0;
+			}
+			slot = &slab[slabCount++];
+		}
+
+		return new(slot) T();
+	}
+
+	template <typename T>
+	void Pool<T>::Free(T* ptr)
+	{
+		assert(ptr);
+		ptr->~T();
+		const auto slot = reinterpret_cast<Slot*>(ptr);
+		*reinterpret_cast<Slot**>(slot) = freeList;
+		freeList = slot;
+	}
+
+	template <typename T>
+	void Pool<T>::Clear()
+	{
+		slab = nullptr;
+		slabCount = 0;
+		freeList = nullptr;
+	}
+}
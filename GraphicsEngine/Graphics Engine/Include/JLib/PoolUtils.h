@@ -0,0 +1,15 @@
+#pragma once
+#include "Pool.h"
+
+namespace jv
+{
+	template <typename T>
+	Pool<T> CreatePool(Arena& arena, const uint32_t slabLength)
+	{
+		assert(slabLength > 0);
+		Pool<T> pool{};
+		pool.arena = &arena;
+		pool.slabLength = slabLength;
+		return pool;
+	}
+}
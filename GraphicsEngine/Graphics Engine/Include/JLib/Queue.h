@@ -6,11 +6,10 @@ namespace jv
 	template <typename T>
 	struct Queue;
 
-	// Nonlinear data container that uses a First In First Out structure.
 	template <typename T>
 	struct QueueIterator final
 	{
-		Queue<T>* ptr = nullptr;
+		const Queue<T>* queue = nullptr;
 		uint32_t index = 0;
 
 		T& operator*() const;
@@ -30,6 +29,8 @@ namespace jv
 		}
 	};
 
+	// Nonlinear data container that uses a First In First Out structure.
+	// Implemented as a fixed size ring buffer, so elements can be added and removed at both ends in O(1).
 	template <typename T>
 	struct Queue final
 	{
@@ -38,13 +39,22 @@ namespace jv
 		uint32_t count = 0;
 		uint32_t front = 0;
 
+		// Index 0 is the front of the queue.
 		[[nodiscard]] T& operator[](uint32_t i) const;
 		[[nodiscard]] QueueIterator<T> begin() const;
 		[[nodiscard]] QueueIterator<T> end() const;
 
+		// Adds an element to the back of the queue.
 		T& Add();
+		// Adds an element to the front of the queue.
+		T& AddFront();
 		[[nodiscard]] T& Peek() const;
+		[[nodiscard]] T& PeekBack() const;
+		// Removes the element at the front of the queue.
 		T Pop();
+		// Removes the element at the back of the queue.
+		T PopBack();
+		void Clear();
 
 		[[nodiscard]] uint32_t GetIndex(uint32_t i) const;
 	};
@@ -52,17 +62,15 @@ namespace jv
 	template <typename T>
 	T& QueueIterator<T>::operator*() const
 	{
-		assert(ptr);
-		assert(index <= ptr->length);
-		return ptr[index];
+		assert(queue);
+		return (*queue)[index];
 	}
 
 	template <typename T>
 	T& QueueIterator<T>::operator->() const
 	{
-		assert(ptr);
-		assert(index <= ptr->length);
-		return ptr[index];
+		assert(queue);
+		return (*queue)[index];
 	}
 
 	template <typename T>
@@ -75,7 +83,7 @@ namespace jv
 	template <typename T>
 	QueueIterator<T> QueueIterator<T>::operator++(int)
 	{
-		Iterator temp(ptr, ptr->length, index);
+		QueueIterator temp = *this;
 		++index;
 		return temp;
 	}
@@ -91,8 +99,7 @@ namespace jv
 	QueueIterator<T> Queue<T>::begin() const
 	{
 		QueueIterator<T> it{};
-		it.length = count;
-		it.ptr = ptr;
+		it.queue = this;
 		return it;
 	}
 
@@ -100,9 +107,8 @@ namespace jv
 	QueueIterator<T> Queue<T>::end() const
 	{
 		QueueIterator<T> it{};
-		it.length = count;
+		it.queue = this;
 		it.index = count;
-		it.ptr = ptr;
 		return it;
 	}
 
@@ -113,8 +119,24 @@ namespace jv
 		return ptr[GetIndex(count++)];
 	}
 
+	template <typename T>
+	T& Queue<T>::AddFront()
+	{
+		assert(count < length);
+		front = front == 0 ? length - 1 : front - 1;
+		++count;
+		return ptr[front];
+	}
+
 	template <typename T>
 	T& Queue<T>::Peek() const
+	{
+		assert(count > 0);
+		return ptr[front];
+	}
+
+	template <typename T>
+	T& Queue<T>::PeekBack() const
 	{
 		assert(count > 0);
 		return ptr[GetIndex(count - 1)];
@@ -122,14 +144,32 @@ namespace jv
 
 	template <typename T>
 	T Queue<T>::Pop()
+	{
+		assert(count > 0);
+		const uint32_t index = front;
+		front = front + 1 == length ? 0 : front + 1;
+		--count;
+		return ptr[index];
+	}
+
+	template <typename T>
+	T Queue<T>::PopBack()
 	{
 		assert(count > 0);
 		return ptr[GetIndex(--count)];
 	}
 
+	template <typename T>
+	void Queue<T>::Clear()
+	{
+		count = 0;
+		front = 0;
+	}
+
 	template <typename T>
 	uint32_t Queue<T>::GetIndex(const uint32_t i) const
 	{
-		return (i + front + length) % length;
+		const uint32_t index = front + i;
+		return index >= length ? index - length : index;
 	}
 }
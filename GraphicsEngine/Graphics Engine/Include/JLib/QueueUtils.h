@@ -1,5 +1,7 @@
 #pragma once
 #include "Queue.h"
+#include "ConcurrentQueue.h"
+#include "Math.h"
 
 namespace jv
 {
@@ -17,4 +19,47 @@ namespace jv
 	{
 		arena.Free(queue.ptr);
 	}
+
+	template <typename T>
+	SPSCQueue<T> CreateSPSCQueue(Arena& arena, const uint32_t length)
+	{
+		assert(length > 0 && (length & (length - 1)) == 0);
+
+		SPSCQueue<T> queue{};
+		queue.head = arena.New<ConcurrentQueueCounter>(2);
+		queue.tail = &queue.head[1];
+		queue.ptr = arena.New<T>(length, Max<uint32_t>(alignof(T), CACHE_LINE_SIZE));
+		queue.length = length;
+		return queue;
+	}
+
+	template <typename T>
+	void DestroySPSCQueue(Arena& arena, const SPSCQueue<T>& queue)
+	{
+		arena.Free(queue.ptr);
+		arena.Free(queue.head);
+	}
+
+	template <typename T>
+	MPMCQueue<T> CreateMPMCQueue(Arena& arena, const uint32_t length)
+	{
+		assert(length > 0 && (length & (length - 1)) == 0);
+
+		MPMCQueue<T> queue{};
+		queue.head = arena.New<ConcurrentQueueCounter>(2);
+		queue.tail = &queue.head[1];
+		queue.cells = arena.New<typename MPMCQueue<T>::Cell>(length, Max<uint32_t>(alignof(typename MPMCQueue<T>::Cell), CACHE_LINE_SIZE));
+		queue.length = length;
+
+		for (uint32_t i = 0; i < length; ++i)
+			queue.cells[i].sequence.store(i, std::memory_order_relaxed);
+		return queue;
+	}
+
+	template <typename T>
+	void DestroyMPMCQueue(Arena& arena, const MPMCQueue<T>& queue)
+	{
+		arena.Free(queue.cells);
+		arena.Free(queue.head);
+	}
 }
@@ -0,0 +1,111 @@
+#pragma once
+#include <cstdint>
+#include "Array.h"
+#include <tuple>
+#include <utility>
+
+namespace jv
+{
+	// Linear data container that stores every field in its own aligned column (structure of arrays).
+	// Passes that only touch one or two fields can then iterate over tightly packed memory.
+	template <typename ...Fields>
+	struct SoAVector final
+	{
+		template <uint32_t I>
+		using Field = std::tuple_element_t<I, std::tuple<Fields...>>;
+
+		void* columns[sizeof...(Fields)]{};
+		uint32_t length = 0;
+		uint32_t count = 0;
+
+		template <uint32_t I>
+		[[nodiscard]] Array<Field<I>> GetColumn() const;
+		template <uint32_t I>
+		[[nodiscard]] Field<I>& Get(uint32_t i) const;
+
+		uint32_t Add(const Fields&... values);
+		void RemoveAt(uint32_t i);
+		void Clear();
+
+		// Converts every row to an array of structs, for example right before uploading it to the GPU.
+		// The packer is called with the fields of a row and returns the packed struct.
+		template <typename T, typename Packer>
+		void Pack(T* dst, Packer packer) const;
+
+	private:
+		template <size_t ...Is>
+		void SetRow(std::index_sequence<Is...>, uint32_t i, const Fields&... values);
+		template <size_t ...Is>
+		void MoveRow(std::index_sequence<Is...>, uint32_t dst, uint32_t src);
+		template <typename T, typename Packer, size_t ...Is>
+		void PackRows(std::index_sequence<Is...>, T* dst, Packer& packer) const;
+	};
+
+	template <typename ...Fields>
+	template <uint32_t I>
+	Array<typename SoAVector<Fields...>::template Field<I>> SoAVector<Fields...>::GetColumn() const
+	{
+		Array<Field<I>> column{};
+		column.ptr = static_cast<Field<I>*>(columns[I]);
+		column.length = count;
+		return column;
+	}
+
+	template <typename ...Fields>
+	template <uint32_t I>
+	typename SoAVector<Fields...>::template Field<I>& SoAVector<Fields...>::Get(const uint32_t i) const
+	{
+		assert(i < count);
+		return static_cast<Field<I>*>(columns[I])[i];
+	}
+
+	template <typename ...Fields>
+	uint32_t SoAVector<Fields...>::Add(const Fields&... values)
+	{
+		assert(count < length);
+		SetRow(std::index_sequence_for<Fields...>(), count, values...);
+		return count++;
+	}
+
+	template <typename ...Fields>
+	void SoAVector<Fields...>::RemoveAt(const uint32_t i)
+	{
+		assert(count > i);
+		MoveRow(std::index_sequence_for<Fields...>(), i, --count);
+	}
+
+	template <typename ...Fields>
+	void SoAVector<Fields...>::Clear()
+	{
+		count = 0;
+	}
+
+	template <typename ...Fields>
+	template <typename T, typename Packer>
+	void SoAVector<Fields...>::Pack(T* dst, Packer packer) const
+	{
+		PackRows(std::index_sequence_for<Fields...>(), dst, packer);
+	}
+
+	template <typename ...Fields>
+	template <size_t ...Is>
+	void SoAVector<Fields...>::SetRow(std::index_sequence<Is...>, const uint32_t i, const Fields&... values)
+	{
+		((static_cast<Fields*>(columns[Is])[i] = values), ...);
+	}
+
+	template <typename ...Fields>
+	template <size_t ...Is>
+	void SoAVector<Fields...>::MoveRow(std::index_sequence<Is...>, const uint32_t dst, const uint32_t src)
+	{
+		((static_cast<Fields*>(columns[Is])[dst] = static_cast<Fields*>(columns[Is])[src]), ...);
+	}
+
+	template <typename ...Fields>
+	template <typename T, typename Packer, size_t ...Is>
+	void SoAVector<Fields...>::PackRows(std::index_sequence<Is...>, T* dst, Packer& packer) const
+	{
+		for (uint32_t i = 0; i < count; ++i)
+			dst[i] = packer(static_cast<const Fields*>(columns[Is])[i]...);
+	}
+}
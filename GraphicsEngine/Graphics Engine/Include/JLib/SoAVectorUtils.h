@@ -0,0 +1,38 @@
+#pragma once
+#include "SoAVector.h"
+
+namespace jv
+{
+	template <typename ...Fields, size_t ...Is>
+	void InitSoAColumns(SoAVector<Fields...>& vector, char* block, std::index_sequence<Is...>)
+	{
+		// Every column starts on its own cache line.
+		uint32_t offset = 0;
+		((vector.columns[Is] = block + offset,
+			offset += (sizeof(Fields) * vector.length + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE), ...);
+
+		for (uint32_t i = 0; i < vector.length; ++i)
+			(new(&static_cast<Fields*>(vector.columns[Is])[i]) Fields(), ...);
+	}
+
+	template <typename ...Fields>
+	SoAVector<Fields...> CreateSoAVector(Arena& arena, const uint32_t length)
+	{
+		static_assert(((alignof(Fields) <= CACHE_LINE_SIZE) && ...));
+
+		uint32_t size = 0;
+		((size += (sizeof(Fields) * length + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE), ...);
+
+		SoAVector<Fields...> vector{};
+		vector.length = length;
+		const auto block = static_cast<char*>(arena.Alloc(size, CACHE_LINE_SIZE));
+		InitSoAColumns(vector, block, std::index_sequence_for<Fields...>());
+		return vector;
+	}
+
+	template <typename ...Fields>
+	void DestroySoAVector(Arena& arena, const SoAVector<Fields...>& vector)
+	{
+		arena.Free(vector.columns[0]);
+	}
+}
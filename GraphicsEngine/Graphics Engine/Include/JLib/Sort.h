@@ -0,0 +1,193 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+
+namespace jv
+{
+	// Sorts using a comparer functor that returns true if a should be placed before b.
+	// Quicksort that falls back to heapsort when recursing too deep, and to insertion sort for small ranges. Not stable.
+	template <typename T, typename Comparer>
+	void IntroSort(T* arr, uint32_t length, Comparer comparer);
+
+	// Least significant digit radix sort for unsigned 32 or 64 bit keys, sorting from low to high.
+	// If indices is not null, it is reordered along with the keys. Uses the temp arena for the scratch buffers.
+	template <typename Key>
+	void RadixSort(Arena& tempArena, Key* keys, uint32_t length, uint32_t* indices = nullptr);
+
+	template <typename T, typename Comparer>
+	void InsertionSort(T* arr, const uint32_t length, Comparer& comparer)
+	{
+		for (uint32_t i = 1; i < length; ++i)
+		{
+			T value = std::move(arr[i]);
+			uint32_t j = i;
+			while (j > 0 && comparer(value, arr[j - 1]))
+			{
+				arr[j] = std::move(arr[j - 1]);
+				--j;
+			}
+			arr[j] = std::move(value);
+		}
+	}
+
+	template <typename T, typename Comparer>
+	void HeapSortSiftDown(T* arr, uint32_t index, const uint32_t length, Comparer& comparer)
+	{
+		T value = std::move(arr[index]);
+		while (true)
+		{
+			uint32_t child = index * 2 + 1;
+			if (child >= length)
+				break;
+			if (child + 1 < length && comparer(arr[child], arr[child + 1]))
+				++child;
+			if (!comparer(value, arr[child]))
+				break;
+			arr[index] = std::move(arr[child]);
+			index = child;
+		}
+		arr[index] = std::move(value);
+	}
+
+	template <typename T, typename Comparer>
+	void HeapSort(T* arr, const uint32_t length, Comparer& comparer)
+	{
+		if (length < 2)
+			return;
+
+		for (uint32_t i = length / 2; i-- > 0;)
+			HeapSortSiftDown(arr, i, length, comparer);
+		for (uint32_t i = length - 1; i > 0; --i)
+		{
+			std::swap(arr[0], arr[i]);
+			HeapSortSiftDown(arr, 0, i, comparer);
+		}
+	}
+
+	template <typename T, typename Comparer>
+	void IntroSortRange(T* arr, uint32_t length, uint32_t depth, Comparer& comparer)
+	{
+		constexpr uint32_t INSERTION_SORT_THRESHOLD = 16;
+
+		while (length > INSERTION_SORT_THRESHOLD)
+		{
+			if (depth == 0)
+			{
+				HeapSort(arr, length, comparer);
+				return;
+			}
+			--depth;
+
+			// Median of three, which also keeps the partition loops within bounds.
+			const uint32_t mid = (length - 1) / 2;
+			if (comparer(arr[mid], arr[0]))
+				std::swap(arr[mid], arr[0]);
+			if (comparer(arr[length - 1], arr[mid]))
+			{
+				std::swap(arr[length - 1], arr[mid]);
+				if (comparer(arr[mid], arr[0]))
+					std::swap(arr[mid], arr[0]);
+			}
+
+			// Hoare partition.
+			const T pivot = arr[mid];
+			int64_t i = -1;
+			int64_t j = length;
+			while (true)
+			{
+				do ++i; while (comparer(arr[i], pivot));
+				do --j; while (comparer(pivot, arr[j]));
+				if (i >= j)
+					break;
+				std::swap(arr[i], arr[j]);
+			}
+
+			// Recurse into the smaller half and loop on the larger one.
+			const auto split = static_cast<uint32_t>(j + 1);
+			if (split < length - split)
+			{
+				IntroSortRange(arr, split, depth, comparer);
+				arr += split;
+				length -= split;
+			}
+			else
+			{
+				IntroSortRange(arr + split, length - split, depth, comparer);
+				length = split;
+			}
+		}
+
+		InsertionSort(arr, length, comparer);
+	}
+
+	template <typename T, typename Comparer>
+	void IntroSort(T* arr, const uint32_t length, Comparer comparer)
+	{
+		uint32_t depth = 0;
+		for (uint32_t i = length; i > 1; i >>= 1)
+			depth += 2;
+		IntroSortRange(arr, length, depth, comparer);
+	}
+
+	template <typename Key>
+	void RadixSort(Arena& tempArena, Key* keys, const uint32_t length, uint32_t* indices)
+	{
+		static_assert(std::is_same_v<Key, uint32_t> || std::is_same_v<Key, uint64_t>);
+		constexpr uint32_t DIGIT_COUNT = sizeof(Key);
+
+		if (length < 2)
+			return;
+
+		const auto scope = tempArena.CreateScope();
+		auto srcKeys = keys;
+		auto dstKeys = static_cast<Key*>(tempArena.Alloc(sizeof(Key) * length, alignof(Key)));
+		auto srcIndices = indices;
+		auto dstIndices = indices ? static_cast<uint32_t*>(tempArena.Alloc(sizeof(uint32_t) * length)) : nullptr;
+
+		// Build the histograms of all digits in a single pass.
+		uint32_t counts[DIGIT_COUNT][256]{};
+		for (uint32_t i = 0; i < length; ++i)
+			for (uint32_t d = 0; d < DIGIT_COUNT; ++d)
+				++counts[d][(keys[i] >> d * 8) & 0xFF];
+
+		for (uint32_t d = 0; d < DIGIT_COUNT; ++d)
+		{
+			auto& digitCounts = counts[d];
+			const uint32_t shift = d * 8;
+
+			// Skip digits that are the same for every key.
+			if (digitCounts[(srcKeys[0] >> shift) & 0xFF] == length)
+				continue;
+
+			uint32_t offset = 0;
+			for (auto& count : digitCounts)
+			{
+				const uint32_t c = count;
+				count = offset;
+				offset += c;
+			}
+
+			for (uint32_t i = 0; i < length; ++i)
+			{
+				const uint32_t dst = digitCounts[(srcKeys[i] >> shift) & 0xFF]++;
+				dstKeys[dst] = srcKeys[i];
+				if (indices)
+					dstIndices[dst] = srcIndices[i];
+			}
+
+			std::swap(srcKeys, dstKeys);
+			std::swap(srcIndices, dstIndices);
+		}
+
+		if (srcKeys != keys)
+		{
+			memcpy(keys, srcKeys, sizeof(Key) * length);
+			if (indices)
+				memcpy(indices, srcIndices, sizeof(uint32_t) * length);
+		}
+
+		tempArena.DestroyScope(scope);
+	}
+}
@@ -1,5 +1,7 @@
 #pragma once
 #include "Vector.h"
+#include "Math.h"
+#include <utility>
 
 namespace jv
 {
@@ -12,6 +14,39 @@ namespace jv
 		return vector;
 	}
 
+	// Increases the capacity of the vector.
+	// Grows in place when the vector is the most recent allocation in the arena, otherwise the values are moved to a new block.
+	template <typename T>
+	void Reserve(Arena& arena, Vector<T>& vector, const uint32_t length)
+	{
+		if (length <= vector.length)
+			return;
+
+		if (vector.ptr && arena.TryResize(vector.ptr, static_cast<uint32_t>(sizeof(T) * length)))
+		{
+			for (uint32_t i = vector.length; i < length; ++i)
+				new(&vector.ptr[i]) T();
+		}
+		else
+		{
+			T* ptr = arena.New<T>(length);
+			for (uint32_t i = 0; i < vector.count; ++i)
+				ptr[i] = std::move(vector.ptr[i]);
+			vector.ptr = ptr;
+		}
+
+		vector.length = length;
+	}
+
+	// Adds a value to the vector, doubling its capacity if it's full.
+	template <typename T>
+	T& Add(Arena& arena, Vector<T>& vector)
+	{
+		if (vector.count == vector.length)
+			Reserve(arena, vector, Max<uint32_t>(vector.length * 2, 4));
+		return vector.Add();
+	}
+
 	template <typename T>
 	void DestroyVector(Arena& arena, const Vector<T>& vector)
 	{
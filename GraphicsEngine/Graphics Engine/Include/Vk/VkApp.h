@@ -20,5 +20,7 @@ namespace jv::vk
 		VkDevice device = VK_NULL_HANDLE;
 		VkQueue queues[3]{};
 		VkCommandPool commandPool = VK_NULL_HANDLE;
+		// Whether VK_EXT_memory_budget is enabled, so that heap usage and budgets can be queried.
+		bool memoryBudget = false;
 	};
 }
\ No newline at end of file
@@ -1,6 +1,5 @@
 ﻿#pragma once
 #include "JLib/Array.h"
-#include "JLib/LinkedList.h"
 
 namespace jv::vk
 {
@@ -8,30 +7,76 @@ namespace jv::vk
 	struct App;
 
 	// Handles manual memory allocation for graphics memory.
-	// Allocates one or more large chunks of memory which can then be (re)used for smaller linear allocations.
+	// Allocates one or more large pages of memory, which are split up into blocks with a two level segregated fit allocator.
+	// Allocating and freeing is O(1) and blocks can be freed in any order, neighbouring free blocks are merged.
+	// Linear arenas skip the blocks and bump allocate from their pages instead. Their memory is only released by Reset.
 	struct FreeArena final
 	{
+		static constexpr VkDeviceSize DEFAULT_PAGE_SIZE = 32 * 1024 * 1024;
+		static constexpr uint32_t MAX_PAGE_COUNT = 256;
+		static constexpr uint32_t BLOCK_CHUNK_LENGTH = 256;
+		static constexpr uint32_t MAX_BLOCK_CHUNK_COUNT = 1024;
+
 		struct Page final
 		{
-			VkDeviceSize alignment;
 			VkDeviceMemory memory;
 			VkDeviceSize size;
-			VkDeviceSize remaining;
+			// Host address of the page, only set for host visible memory.
+			void* mapped;
+			uint32_t poolId;
+			uint32_t allocationCount;
+			// End of the last allocation, only used by linear arenas.
+			VkDeviceSize top;
+		};
+
+		struct Block final
+		{
+			VkDeviceSize offset;
+			VkDeviceSize size;
+			Page* page;
+			uint32_t index;
+			// Neighbours in memory.
+			Block* prev;
+			Block* next;
+			// Neighbours in the free list, only valid when the block is free.
+			Block* prevFree;
+			Block* nextFree;
+			bool free;
 		};
 
 		struct Pool final
 		{
 			VkFlags memPropertyFlags;
-			LinkedList<Page> pages{};
+			VkDeviceSize pageSize;
+			// Pages never move, so they can be referred to by index. Allocated when the pool gets its first page.
+			Page* pages;
+			uint32_t pageCount;
+			// Page that linear arenas allocate from. The pages after it have been kept after a reset.
+			uint32_t currentPage;
+			// Bit for every first level that has free blocks.
+			uint32_t flBitmap;
+			// Bit for every second level that has free blocks, per first level.
+			uint32_t* slBitmaps;
+			// Free blocks per size class. Allocated when the pool gets its first page.
+			Block** freeLists;
+		};
+
+		// Stable indexable storage for blocks, so that handles can refer to them by index.
+		struct BlockTable final
+		{
+			Block* chunks[MAX_BLOCK_CHUNK_COUNT];
+			uint32_t count;
+			// Unused blocks, linked through nextFree.
+			Block* unused;
 		};
 
 		struct FreeMemory final
 		{
 			struct Unpacked final
 			{
-				uint32_t size;
+				uint32_t blockIndex;
+				uint16_t pageIndex;
 				uint16_t poolId;
-				uint16_t pageNum;
 			};
 
 			union
@@ -40,16 +85,46 @@ namespace jv::vk
 				Unpacked unpacked;
 			};
 		};
-		
-		VkDeviceSize pageSize;
+
+		struct Stats final
+		{
+			uint32_t pageCount = 0;
+			uint32_t emptyPageCount = 0;
+			uint32_t allocationCount = 0;
+			uint32_t freeBlockCount = 0;
+			VkDeviceSize reservedSize = 0;
+			VkDeviceSize usedSize = 0;
+			VkDeviceSize largestFreeBlockSize = 0;
+			// 0 when all free memory in partially used pages is in one block, approaches 1 as it gets split up in smaller blocks.
+			float fragmentation = 0;
+
+			void Print() const;
+		};
+
+		Arena* arena;
 		uint64_t scope;
+		VkDeviceSize bufferImageGranularity;
 		Array<Pool> pools;
+		BlockTable* blocks;
+		bool linear;
 
-		static FreeArena Create(Arena& arena, const App& app, VkDeviceSize pageSize = 4096);
+		// Pages are capped at an eighth of their heap, allocations that don't fit in a page get a page of their own.
+		static FreeArena Create(Arena& arena, const App& app, VkDeviceSize pageSize = DEFAULT_PAGE_SIZE, bool linear = false);
 		static void Destroy(Arena& arena, const App& app, const FreeArena& freeArena);
-		
-		[[nodiscard]] uint64_t Alloc(Arena& arena, const App& app, VkMemoryRequirements memRequirements,
-			VkMemoryPropertyFlags properties, uint32_t count, Memory& outMemory) const;
+
+		// Images with optimal tiling can not share a bufferImageGranularity sized region with buffers.
+		[[nodiscard]] uint64_t Alloc(const App& app, VkMemoryRequirements memRequirements,
+			VkMemoryPropertyFlags properties, uint32_t count, Memory& outMemory, bool optimalTiling = false) const;
+		// Does nothing for linear arenas.
 		void Free(uint64_t handle) const;
+		// Releases every allocation of a linear arena at once. Kept pages are reused by the next allocations.
+		void Reset(const App& app, bool keepPages) const;
+		[[nodiscard]] Stats GetStats() const;
+
+#ifdef JV_FREE_ARENA_SELF_TEST
+		// Allocates and frees tens of thousands of blocks in random order on the device and asserts that they are
+		// aligned, don't overlap, respect bufferImageGranularity and merge back into empty pages once freed.
+		static void SelfTest(Arena& tempArena, const App& app);
+#endif
 	};
 }
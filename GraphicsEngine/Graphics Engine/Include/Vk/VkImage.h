@@ -5,6 +5,7 @@
 namespace jv::vk
 {
 	struct FreeArena;
+	struct StagingRing;
 	struct App;
 
 	struct ImageCreateInfo final
@@ -31,8 +32,8 @@ namespace jv::vk
 
 		// Transition the layout for it to be used in different ways, like for a depth attachment, or a sampled image.
 		void TransitionLayout(VkCommandBuffer cmd, VkImageLayout newLayout, VkImageAspectFlags aspectFlags);
-		void FillImage(Arena& arena, const FreeArena& freeArena, const App& app, unsigned char* pixels, 
-			VkCommandBuffer cmd, glm::ivec2* overrideResolution = nullptr);
+		// Records the upload in the staging ring, it is executed when the ring is flushed.
+		void FillImage(StagingRing& stagingRing, const App& app, unsigned char* pixels, glm::ivec2* overrideResolution = nullptr);
 
 		[[nodiscard]] static Image Create(Arena& arena, const FreeArena& freeArena, const App& app, const ImageCreateInfo& info);
 		static void Destroy(const FreeArena& freeArena, const App& app, const Image& image);
@@ -11,9 +11,9 @@ namespace jv::vk::init
 {
 	struct QueueFamilies final
 	{
-		uint32_t graphics;
-		uint32_t present;
-		uint32_t transfer;
+		uint32_t graphics = UINT32_MAX;
+		uint32_t present = UINT32_MAX;
+		uint32_t transfer = UINT32_MAX;
 
 		[[nodiscard]] operator bool() const;
 	};
@@ -8,5 +8,7 @@ namespace jv::vk
 		VkDeviceMemory memory;
 		VkDeviceSize offset;
 		VkDeviceSize size;
+		// Host address of the memory, only set for host visible memory.
+		void* mapped;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,65 @@
+﻿#pragma once
+#include "JLib/Array.h"
+
+namespace jv::vk
+{
+	struct App;
+
+	// Persistently mapped ring of host visible memory that uploads to the GPU are copied through.
+	// Copies are recorded into a shared command buffer and submitted together on Flush.
+	// Ring space is reclaimed once the fence of the submission that used it has been signaled.
+	// When the device has a dedicated transfer queue, copies run on it and the uploaded resources are handed over to the render queue.
+	struct StagingRing final
+	{
+		struct Submission final
+		{
+			// Recorded on the transfer queue.
+			VkCommandBuffer cmd;
+			// Recorded on the render queue, waits for the copies and acquires the uploaded resources.
+			VkCommandBuffer acquireCmd;
+			VkSemaphore semaphore;
+			VkFence fence;
+			// Ring position after the last upload in this submission.
+			uint64_t end;
+			bool pending;
+		};
+
+		VkBuffer buffer;
+		VkDeviceMemory memory;
+		void* mapped;
+		VkDeviceSize size;
+		VkCommandPool commandPool;
+		uint32_t transferQueueFamily;
+		uint32_t renderQueueFamily;
+		// Whether the copies run on a different queue family than rendering.
+		bool transferOwnership;
+		// Total amount of bytes handed out and reclaimed, the ring offset is this modulo the size.
+		uint64_t head;
+		uint64_t tail;
+		Array<Submission> submissions;
+		uint32_t current;
+		uint32_t oldest;
+		// Stages of the render queue that wait for the current submission.
+		VkPipelineStageFlags acquireStageMask;
+		bool recording;
+
+		// Copies the data into the ring and returns the command buffer to record the copy from it in.
+		// Blocks if the ring is full until enough of it has been reclaimed. Throws if the data is larger than GetMaxStageSize.
+		[[nodiscard]] VkCommandBuffer Stage(const App& app, const void* data, VkDeviceSize dataSize, VkDeviceSize& outOffset);
+		// Uploads that are larger than this have to be split up over multiple copies.
+		// Half of the ring, so that the next part can be staged while the previous one is being copied.
+		[[nodiscard]] VkDeviceSize GetMaxStageSize() const;
+		// Makes an uploaded buffer available to the render queue, call after recording the copy.
+		void ReleaseBuffer(VkBuffer buffer, VkAccessFlags dstAccessMask, VkPipelineStageFlags dstStageMask);
+		// Makes an uploaded image available to the render queue and transitions it from the transfer layout to the new layout.
+		void ReleaseImage(VkImage image, VkImageAspectFlags aspectFlags, VkImageLayout newLayout,
+			VkAccessFlags dstAccessMask, VkPipelineStageFlags dstStageMask);
+		// Submits the recorded uploads. Everything submitted to the render queue afterwards sees them.
+		void Flush(const App& app);
+		// Submits the recorded uploads and waits until all of them have finished.
+		void Wait(const App& app);
+
+		[[nodiscard]] static StagingRing Create(Arena& arena, Arena& tempArena, const App& app, VkDeviceSize size, uint32_t submissionCount = 4);
+		static void Destroy(Arena& arena, const App& app, const StagingRing& stagingRing);
+	};
+}
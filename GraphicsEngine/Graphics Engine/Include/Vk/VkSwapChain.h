@@ -41,7 +41,8 @@ namespace jv::vk
 		// Wait until an image is available to draw to.
 		void WaitForImage(const App& app);
 		// Call this at the start of the frame.
-		[[nodiscard]] VkCommandBuffer BeginFrame(const App& app, bool manuallyCallWaitForImage = false);
+		[[nodiscard]] VkCommandBuffer BeginFrame(const App& app, bool manuallyCallWaitForImage = false,
+			VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
 		// Call this at the end of the frame, after you've drawn everything.
 		void EndFrame(Arena& tempArena, const App& app, const Array<VkSemaphore>& waitSemaphores = {});
 
@@ -6,6 +6,7 @@ namespace jv::vk
 {
 	struct App;
 	struct FreeArena;
+	struct StagingRing;
 	typedef uint16_t VertexIndex;
 
 	// Model used for rendering.
@@ -15,8 +16,10 @@ namespace jv::vk
 		Buffer indexBuffer;
 		uint32_t indexCount;
 
-		void Draw(Arena& tempArena, VkCommandBuffer cmd, uint32_t count) const;
-		static Mesh Create(Arena& arena, const FreeArena& freeArena, const App& app,
+		// Records the draw call. Safe to call from multiple threads, as long as they use different command buffers.
+		void Draw(VkCommandBuffer cmd, uint32_t count) const;
+		// Uploads go through the staging ring, the mesh can be drawn once the ring has been flushed.
+		static Mesh Create(Arena& arena, const FreeArena& freeArena, const App& app, StagingRing& stagingRing,
 			void** attributes, const uint32_t* attributeSizes, uint32_t attributeCount, const Array<VertexIndex>& indices);
 		static void Destroy(Arena& arena, const FreeArena& freeArena, const App& app, const Mesh& mesh, bool freeArenaMemory);
 	};
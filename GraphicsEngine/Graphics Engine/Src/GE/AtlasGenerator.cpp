@@ -1,7 +1,11 @@
 ﻿#include "pch.h"
 #include "GE/AtlasGenerator.h"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <fstream>
+#include <thread>
 #include <stb_image.h>
 #include <stb_image_write.h>
 
@@ -11,55 +15,126 @@
 
 namespace jv::ge
 {
-	void GenerateAtlas(Arena& arena, Arena& tempArena, const Array<const char*>& filePaths, const char* imageFilePath,
-		const char* metaFilePath)
+	using AtlasClock = std::chrono::high_resolution_clock;
+
+	float GetMillisecondsSince(const AtlasClock::time_point start)
 	{
-		const auto _ = tempArena.CreateScope();
-		const auto shapes = CreateArray<glm::ivec2>(tempArena, filePaths.length);
+		return std::chrono::duration<float, std::milli>(AtlasClock::now() - start).count();
+	}
 
+	// Calls func for every index in [0, count), spread over threadCount threads including the calling one.
+	template <typename Func>
+	void ParallelFor(Arena& tempArena, const uint32_t threadCount, const size_t count, const Func& func)
+	{
+		std::atomic<size_t> next = 0;
+		const auto work = [&]
+		{
+			for (size_t i = next++; i < count; i = next++)
+				func(i);
+		};
+
+		const auto scope = tempArena.CreateScope();
+		const uint32_t workerCount = threadCount - 1;
+		const auto workers = static_cast<std::thread*>(tempArena.Alloc(sizeof(std::thread) * workerCount, alignof(std::thread)));
+		for (uint32_t i = 0; i < workerCount; ++i)
+			new(&workers[i]) std::thread(work);
+		work();
+		for (uint32_t i = 0; i < workerCount; ++i)
 		{
-			size_t i = 0;
-			for (const auto& path : filePaths)
-			{
-				// Load pixels.
-				int texWidth, texHeight, texChannels;
-				stbi_uc* pixels = stbi_load(path, &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-				assert(pixels);
-				assert(texChannels == 4);
-				shapes[i++] = glm::ivec2(texWidth, texHeight);
-
-				// Free pixels.
-				stbi_image_free(pixels);
-			}
+			workers[i].join();
+			workers[i].~thread();
 		}
+		tempArena.DestroyScope(scope);
+	}
+
+	struct AtlasEncoder final
+	{
+		std::thread thread;
+		AtlasGenerationTimings timings;
+	};
+
+	GeneratedAtlas::GeneratedAtlas(GeneratedAtlas&& other) noexcept : pixels(other.pixels), resolution(other.resolution),
+		encoder(other.encoder)
+	{
+		other.encoder = nullptr;
+	}
+
+	GeneratedAtlas::~GeneratedAtlas()
+	{
+		// A joinable thread that gets destroyed terminates the program.
+		if (encoder)
+			FinishAtlas(*this);
+	}
+
+	GeneratedAtlas GenerateAtlas(Arena& arena, Arena& tempArena, const Array<const char*>& filePaths, const char* imageFilePath,
+		const char* metaFilePath, uint32_t threadCount)
+	{
+		const auto totalStart = AtlasClock::now();
+		const auto encoder = tempArena.New<AtlasEncoder>();
+		auto& timings = encoder->timings;
+
+		if (threadCount == 0)
+			threadCount = std::thread::hardware_concurrency();
+		if (threadCount == 0)
+			threadCount = 1;
+
+		const auto shapes = CreateArray<glm::ivec2>(tempArena, filePaths.length);
+		const auto pixels = CreateArray<stbi_uc*>(tempArena, filePaths.length);
+
+		// Decode every image once, and keep the pixels around until they have been blitted.
+		auto phaseStart = AtlasClock::now();
+		ParallelFor(tempArena, threadCount, filePaths.length, [&](const size_t i)
+		{
+			int texWidth, texHeight, texChannels;
+			pixels[i] = stbi_load(filePaths[i], &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+			assert(pixels[i]);
+			assert(texChannels == 4);
+			shapes[i] = glm::ivec2(texWidth, texHeight);
+		});
+		timings.decode = GetMillisecondsSince(phaseStart);
 
+		phaseStart = AtlasClock::now();
 		glm::ivec2 area;
 		const auto positions = Pack(arena, tempArena, shapes, area);
 		const auto atlasPixels = CreateArray<stbi_uc>(tempArena, static_cast<size_t>(area.x) * area.y * 4);
 
+		// First row of every image when all rows are laid out after each other.
+		const auto rowOffsets = CreateArray<size_t>(tempArena, filePaths.length + 1);
+		for (size_t i = 0; i < filePaths.length; ++i)
+			rowOffsets[i + 1] = rowOffsets[i] + shapes[i].y;
+		timings.pack = GetMillisecondsSince(phaseStart);
+
 		const auto rowLength = static_cast<size_t>(area.x) * 4;
 
-		for (size_t i = 0; i < filePaths.length; ++i)
+		// Packed images don't overlap, so their rows can be blitted in parallel.
+		phaseStart = AtlasClock::now();
+		ParallelFor(tempArena, threadCount, rowOffsets[filePaths.length], [&](const size_t row)
 		{
-			const auto& path = filePaths[i];
+			const size_t i = std::upper_bound(rowOffsets.ptr, rowOffsets.ptr + rowOffsets.length, row) - rowOffsets.ptr - 1;
+			const size_t y = row - rowOffsets[i];
 			const auto& position = positions[i];
 
-			// Load pixels.
-			int texWidth, texHeight, texChannels;
-			stbi_uc* pixels = stbi_load(path, &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-			assert(pixels);
-			assert(texChannels == 4);
-
-			const size_t width = static_cast<size_t>(texWidth) * texChannels;
-			const size_t start = position.y * rowLength + static_cast<size_t>(position.x) * 4;
-			for (int y = 0; y < texHeight; ++y)
-				memcpy(&atlasPixels.ptr[start + rowLength * y], &pixels[static_cast<size_t>(texWidth) * 4 * y], width);
-
-			// Free pixels.
-			stbi_image_free(pixels);
-		}
-
-		stbi_write_png(imageFilePath, area.x, area.y, 4, atlasPixels.ptr, 0);
+			const size_t width = static_cast<size_t>(shapes[i].x) * 4;
+			const size_t start = (position.y + y) * rowLength + static_cast<size_t>(position.x) * 4;
+			memcpy(&atlasPixels.ptr[start], &pixels[i][width * y], width);
+		});
+
+		// Free pixels.
+		for (const auto ptr : pixels)
+			stbi_image_free(ptr);
+		timings.blit = GetMillisecondsSince(phaseStart);
+
+		// From here on the atlas owns the encoder, so it is finished if writing the meta data throws.
+		GeneratedAtlas atlas{};
+		atlas.pixels = atlasPixels.ptr;
+		atlas.resolution = area;
+		encoder->thread = std::thread([encoder, imageFilePath, area, atlasPixels]
+		{
+			const auto encodeStart = AtlasClock::now();
+			stbi_write_png(imageFilePath, area.x, area.y, 4, atlasPixels.ptr, 0);
+			encoder->timings.encode = GetMillisecondsSince(encodeStart);
+		});
+		atlas.encoder = encoder;
 
 		std::ofstream outfile;
 		outfile.open(metaFilePath);
@@ -83,6 +158,19 @@ namespace jv::ge
 		}
 
 		outfile.close();
+		timings.total = GetMillisecondsSince(totalStart);
+		return atlas;
+	}
+
+	void FinishAtlas(GeneratedAtlas& atlas, AtlasGenerationTimings* outTimings)
+	{
+		const auto encoder = atlas.encoder;
+		assert(encoder);
+		encoder->thread.join();
+		if (outTimings)
+			*outTimings = encoder->timings;
+		encoder->~AtlasEncoder();
+		atlas.encoder = nullptr;
 	}
 
 	Array<AtlasTexture> LoadAtlasMetaData(Arena& arena, const char* metaFilePath)
@@ -5,12 +5,15 @@
 #include "JLib/ArrayUtils.h"
 #include "JLib/LinkedList.h"
 #include "JLib/LinkedListUtils.h"
+#include "JLib/Math.h"
+#include "JLib/PoolUtils.h"
 #include "Vk/VkFreeArena.h"
 #include "Vk/VkImage.h"
 #include "Vk/VkInit.h"
 #include "Vk/VkLayout.h"
 #include "Vk/VkPipeline.h"
 #include "Vk/VkShader.h"
+#include "Vk/VkStagingRing.h"
 #include "Vk/VkSwapChain.h"
 #include "VkHL/VkGLFWApp.h"
 #include "VkHL/VkMesh.h"
@@ -19,6 +22,7 @@
 namespace jv::ge
 {
 	constexpr uint32_t ARENA_SIZE = 4096;
+	constexpr uint32_t MAX_WRITE_BINDING_COUNT = 8;
 
 	struct Image final
 	{
@@ -38,6 +42,9 @@ namespace jv::ge
 	{
 		vk::Buffer buffer;
 		BufferCreateInfo info;
+		// Distance between the slices of a dynamic buffer.
+		uint32_t sliceStride;
+		bool coherent;
 	};
 
 	struct Sampler final
@@ -106,12 +113,17 @@ namespace jv::ge
 	{
 		Array<VkDescriptorSetLayout> layouts;
 		vk::Pipeline pipeline;
+		VkRenderPass renderPass;
 	};
 
 	struct Scene final
 	{
 		Arena arena;
 		void* arenaMem;
+		ArenaStats arenaStats{ "Scene arena" };
+		// Holds the free arena's pages, so that they survive clearing the scene arena.
+		Arena memoryArena;
+		void* memoryArenaMem;
 		vk::FreeArena freeArena;
 		LinkedList<Allocation> allocations;
 	};
@@ -122,6 +134,25 @@ namespace jv::ge
 		uint32_t activeCount = 0;
 	};
 
+	struct DrawBatch final
+	{
+		VkCommandBuffer cmd;
+		// Render pass the batch is recorded for. Null until the first draw call.
+		VkRenderPass renderPass;
+		uint32_t order;
+		bool executed;
+	};
+
+	// Secondary command buffers that a single thread records into during a single frame.
+	struct DrawBatchPool final
+	{
+		VkCommandPool commandPool;
+		VkCommandBuffer* cmdBuffers;
+		DrawBatch* batches;
+		uint32_t allocatedCount = 0;
+		uint32_t count = 0;
+	};
+
 	struct GraphicsEngine final
 	{
 		bool initialized = false;
@@ -133,6 +164,11 @@ namespace jv::ge
 		Arena frameArena;
 		void* frameArenaMem;
 
+		bool trackArenaStats;
+		ArenaStats arenaStats{ "GE arena" };
+		ArenaStats tempArenaStats{ "GE temp arena" };
+		ArenaStats frameArenaStats{ "GE frame arena" };
+
 		void (*onKeyCallback)(size_t key, size_t action);
 		void (*onMouseCallback)(size_t key, size_t action);
 		void (*onScrollCallback)(glm::vec<2, double> offset);
@@ -142,6 +178,10 @@ namespace jv::ge
 		vk::SwapChain swapChain;
 		uint64_t scope;
 		
+		Pool<LinkedListNode<Scene>> scenePool{};
+		Pool<LinkedListNode<Pipeline>> pipelinePool{};
+		Pool<LinkedListNode<Allocation>> allocationPool{};
+
 		LinkedList<Scene> scenes{};
 		LinkedList<Shader> shaders{};
 		LinkedList<Layout> layouts{};
@@ -155,8 +195,18 @@ namespace jv::ge
 
 		Array<CmdBufferPool> cmdPools{};
 		VkCommandBuffer cmd;
+		vk::StagingRing stagingRing{};
+
+		// One pool per thread for every frame in flight.
+		Array<DrawBatchPool> drawBatchPools{};
+		uint32_t drawBatchThreadCount;
+		uint32_t drawBatchCapacity;
 	} ge{};
 
+	// Draw batch that is being recorded on this thread.
+	thread_local DrawBatch* activeDrawBatch = nullptr;
+	thread_local uint32_t renderFrameThreadIndex = 0;
+
 	void GLFWKeyCallback(GLFWwindow* window, const int key, const int scancode, const int action, const int mods)
 	{
 		if (ge.onKeyCallback)
@@ -222,17 +272,26 @@ namespace jv::ge
 		ge.tempArenaMem = malloc(ARENA_SIZE);
 		ge.frameArenaMem = malloc(ARENA_SIZE);
 
+		ge.trackArenaStats = info.trackArenaStats;
+
 		ArenaCreateInfo arenaInfo{};
 		arenaInfo.alloc = Alloc;
 		arenaInfo.free = Free;
 		arenaInfo.memory = ge.arenaMem;
 		arenaInfo.memorySize = ARENA_SIZE;
+		arenaInfo.stats = ge.trackArenaStats ? &ge.arenaStats : nullptr;
 		ge.arena = Arena::Create(arenaInfo);
 		arenaInfo.memory = ge.tempArenaMem;
+		arenaInfo.stats = ge.trackArenaStats ? &ge.tempArenaStats : nullptr;
 		ge.tempArena = Arena::Create(arenaInfo);
 		arenaInfo.memory = ge.frameArenaMem;
+		arenaInfo.stats = ge.trackArenaStats ? &ge.frameArenaStats : nullptr;
 		ge.frameArena = Arena::Create(arenaInfo);
 
+		ge.scenePool = CreatePool<LinkedListNode<Scene>>(ge.arena, 4);
+		ge.pipelinePool = CreatePool<LinkedListNode<Pipeline>>(ge.arena, 16);
+		ge.allocationPool = CreatePool<LinkedListNode<Allocation>>(ge.arena, 64);
+
 		ge.onKeyCallback = info.onKeyCallback;
 		ge.onMouseCallback = info.onMouseCallback;
 		ge.onScrollCallback = info.onScrollCallback;
@@ -254,10 +313,40 @@ namespace jv::ge
 		vkInfo.userPtr = &ge.glfwApp;
 		vkInfo.instanceExtensions = extensions;
 		ge.app = CreateApp(vkInfo);
+#ifdef JV_FREE_ARENA_SELF_TEST
+		vk::FreeArena::SelfTest(ge.tempArena, ge.app);
+#endif
 
 		ge.swapChain = vk::SwapChain::Create(ge.arena, ge.tempArena, ge.app, res);
 		ge.cmdPools = CreateArray<CmdBufferPool>(ge.arena, ge.swapChain.GetLength());
 
+		assert(info.drawBatchThreadCount > 0);
+		ge.drawBatchThreadCount = info.drawBatchThreadCount;
+		ge.drawBatchCapacity = info.drawBatchCapacity;
+		ge.drawBatchPools = CreateArray<DrawBatchPool>(ge.arena, ge.swapChain.GetLength() * info.drawBatchThreadCount);
+		{
+			const auto families = vk::init::GetQueueFamilies(ge.tempArena, ge.app.physicalDevice, ge.app.surface);
+
+			VkCommandPoolCreateInfo poolInfo{};
+			poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+			poolInfo.queueFamilyIndex = families.graphics;
+			poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+			const uint32_t poolCount = ge.drawBatchPools.length;
+			const auto cmdBuffers = ge.arena.New<VkCommandBuffer>(poolCount * info.drawBatchCapacity);
+			const auto batches = ge.arena.New<DrawBatch>(poolCount * info.drawBatchCapacity);
+
+			for (uint32_t i = 0; i < poolCount; ++i)
+			{
+				auto& pool = ge.drawBatchPools[i] = {};
+				const auto result = vkCreateCommandPool(ge.app.device, &poolInfo, nullptr, &pool.commandPool);
+				assert(!result);
+				pool.cmdBuffers = &cmdBuffers[i * info.drawBatchCapacity];
+				pool.batches = &batches[i * info.drawBatchCapacity];
+			}
+		}
+
+		ge.stagingRing = vk::StagingRing::Create(ge.arena, ge.tempArena, ge.app, info.stagingRingSize);
 		ge.scope = ge.arena.CreateScope();
 
 		VkCommandBufferAllocateInfo cmdBufferAllocInfo{};
@@ -299,7 +388,7 @@ namespace jv::ge
 		constexpr uint32_t SCENE_ARENA_SIZE = 512;
 		assert(ge.initialized);
 
-		auto& scene = Add(ge.arena, ge.scenes) = {};
+		auto& scene = Add(ge.scenePool, ge.scenes) = {};
 		scene.arenaMem = malloc(SCENE_ARENA_SIZE);
 
 		ArenaCreateInfo arenaInfo{};
@@ -307,16 +396,26 @@ namespace jv::ge
 		arenaInfo.free = Free;
 		arenaInfo.memory = scene.arenaMem;
 		arenaInfo.memorySize = SCENE_ARENA_SIZE;
+		arenaInfo.stats = ge.trackArenaStats ? &scene.arenaStats : nullptr;
 		scene.arena = Arena::Create(arenaInfo);
-		scene.freeArena = vk::FreeArena::Create(scene.arena, ge.app);
+
+		scene.memoryArenaMem = malloc(SCENE_ARENA_SIZE);
+		arenaInfo.memory = scene.memoryArenaMem;
+		arenaInfo.stats = nullptr;
+		scene.memoryArena = Arena::Create(arenaInfo);
+		// Scene resources are only destroyed together, so device memory is allocated linearly.
+		scene.freeArena = vk::FreeArena::Create(scene.memoryArena, ge.app, vk::FreeArena::DEFAULT_PAGE_SIZE, true);
 
 		return &scene;
 	}
 
-	void ClearScene(const Resource sceneHandle)
+	void ClearScene(const Resource sceneHandle, const bool keepMemory)
 	{
 		assert(ge.initialized);
 		const auto scene = static_cast<Scene*>(sceneHandle);
+
+		// Pending uploads might still write to the resources of this scene.
+		ge.stagingRing.Wait(ge.app);
 		
 		for (const auto& allocation : scene->allocations)
 		{
@@ -343,15 +442,17 @@ namespace jv::ge
 			}
 		}
 
+		// The resources above don't give their memory back, it's all released here at once.
+		scene->freeArena.Reset(ge.app, keepMemory);
 		scene->arena.Clear();
-		scene->allocations = {};
+		DestroyLinkedList(ge.allocationPool, scene->allocations);
 	}
 
 	Resource AddImage(const ImageCreateInfo& info)
 	{
 		assert(ge.initialized);
 		const auto scene = static_cast<Scene*>(info.scene);
-		auto& allocation = Add(scene->arena, scene->allocations) = {};
+		auto& allocation = Add(ge.allocationPool, scene->allocations) = {};
 		allocation.type = Allocation::Type::image;
 		auto& image = allocation.image = {};
 
@@ -420,14 +521,14 @@ namespace jv::ge
 		assert(ge.initialized);
 		const auto pImage = static_cast<Image*>(image);
 		const auto scene = pImage->scene;
-		pImage->image.FillImage(scene->arena, scene->freeArena, ge.app, pixels, ge.cmd, overrideResolution);
+		pImage->image.FillImage(ge.stagingRing, ge.app, pixels, overrideResolution);
 	}
 
 	Resource AddMesh(MeshCreateInfo& info)
 	{
 		assert(ge.initialized);
 		const auto scene = static_cast<Scene*>(info.scene);
-		auto& allocation = Add(scene->arena, scene->allocations) = {};
+		auto& allocation = Add(ge.allocationPool, scene->allocations) = {};
 		allocation.type = Allocation::Type::mesh;
 		auto& mesh = allocation.mesh = {};
 
@@ -465,7 +566,7 @@ namespace jv::ge
 
 		void** ptr = &info.vertices;
 
-		vkMesh = vk::Mesh::Create(scene->arena, scene->freeArena, ge.app, ptr, &size, 1, indices);
+		vkMesh = vk::Mesh::Create(scene->arena, scene->freeArena, ge.app, ge.stagingRing, ptr, &size, 1, indices);
 		mesh.mesh = vkMesh;
 		mesh.info = info;
 		return &mesh;
@@ -475,13 +576,25 @@ namespace jv::ge
 	{
 		assert(ge.initialized);
 		const auto scene = static_cast<Scene*>(info.scene);
-		auto& allocation = Add(scene->arena, scene->allocations) = {};
+		auto& allocation = Add(ge.allocationPool, scene->allocations) = {};
 		allocation.type = Allocation::Type::buffer;
 		auto& buffer = allocation.buffer = {};
 
+		// Slices have to be valid descriptor offsets, and flushing them can't touch the neighbouring slices.
+		VkDeviceSize alignment = 1;
+		buffer.sliceStride = info.size;
+		if (info.dynamic)
+		{
+			VkPhysicalDeviceProperties properties{};
+			vkGetPhysicalDeviceProperties(ge.app.physicalDevice, &properties);
+			alignment = Max(Max(properties.limits.minUniformBufferOffsetAlignment, 
+				properties.limits.minStorageBufferOffsetAlignment), properties.limits.nonCoherentAtomSize);
+			buffer.sliceStride = static_cast<uint32_t>((info.size + alignment - 1) / alignment * alignment);
+		}
+
 		VkBufferCreateInfo vertBufferInfo{};
 		vertBufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-		vertBufferInfo.size = info.size;
+		vertBufferInfo.size = info.dynamic ? buffer.sliceStride * GetFrameCount() : info.size;
 		vertBufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
 		switch (info.type)
@@ -502,9 +615,17 @@ namespace jv::ge
 
 		VkMemoryRequirements memRequirements;
 		vkGetBufferMemoryRequirements(ge.app.device, vkBuffer.buffer, &memRequirements);
+		memRequirements.alignment = Max(memRequirements.alignment, alignment);
 
-		constexpr VkMemoryPropertyFlags memoryPropertyFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-		vkBuffer.memoryHandle = scene->freeArena.Alloc(scene->arena, ge.app, memRequirements, memoryPropertyFlags, 1, vkBuffer.memory);
+		// Dynamic buffers take any host visible memory, and flush it themselves if it isn't coherent.
+		const VkMemoryPropertyFlags memoryPropertyFlags = info.dynamic ? VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT :
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+		vkBuffer.memoryHandle = scene->freeArena.Alloc(ge.app, memRequirements, memoryPropertyFlags, 1, vkBuffer.memory);
+
+		vk::FreeArena::FreeMemory freeMemory;
+		freeMemory.handle = vkBuffer.memoryHandle;
+		const auto& pool = scene->freeArena.pools[freeMemory.unpacked.poolId];
+		buffer.coherent = pool.memPropertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
 
 		vkBindBufferMemory(ge.app.device, vkBuffer.buffer, vkBuffer.memory.memory, vkBuffer.memory.offset);
 
@@ -545,7 +666,7 @@ namespace jv::ge
 	{
 		assert(ge.initialized);
 		const auto scene = static_cast<Scene*>(info.scene);
-		auto& allocation = Add(scene->arena, scene->allocations) = {};
+		auto& allocation = Add(ge.allocationPool, scene->allocations) = {};
 		allocation.type = Allocation::Type::sampler;
 		auto& sampler = allocation.sampler = {};
 
@@ -593,7 +714,7 @@ namespace jv::ge
 		assert(ge.initialized);
 		const auto layout = static_cast<Layout*>(info.layout);
 		const auto scene = static_cast<Scene*>(info.scene);
-		auto& allocation = Add(scene->arena, scene->allocations) = {};
+		auto& allocation = Add(ge.allocationPool, scene->allocations) = {};
 		allocation.type = Allocation::Type::pool;
 		auto& pool = allocation.pool = {};
 
@@ -655,10 +776,14 @@ namespace jv::ge
 	void Write(const WriteInfo& info)
 	{
 		assert(ge.initialized);
-		const auto scope = ge.tempArena.CreateScope();
+		assert(info.bindingCount <= MAX_WRITE_BINDING_COUNT);
 		const auto& descriptorSet = static_cast<VkDescriptorSet>(info.descriptorSet);
 
-		const auto writes = CreateArray<VkWriteDescriptorSet>(ge.tempArena, info.bindingCount);
+		// Kept on the stack so that descriptor sets can be written from multiple threads.
+		VkWriteDescriptorSet writes[MAX_WRITE_BINDING_COUNT];
+		VkDescriptorBufferInfo bufferInfos[MAX_WRITE_BINDING_COUNT];
+		VkDescriptorImageInfo imageInfos[MAX_WRITE_BINDING_COUNT];
+
 		for (uint32_t i = 0; i < info.bindingCount; ++i)
 		{
 			const auto& writeInfo = info.bindings[i];
@@ -678,7 +803,7 @@ namespace jv::ge
 			switch (writeInfo.type)
 			{
 				case BindingType::uniformBuffer:
-					bufferInfo = ge.tempArena.New<VkDescriptorBufferInfo>();
+					bufferInfo = &bufferInfos[i];
 					*bufferInfo = {};
 					buffer = static_cast<Buffer*>(writeInfo.buffer.buffer);
 					bufferInfo->buffer = buffer->buffer.buffer;
@@ -688,7 +813,7 @@ namespace jv::ge
 					write.pBufferInfo = bufferInfo;
 					break;
 				case BindingType::storageBuffer:
-					bufferInfo = ge.tempArena.New<VkDescriptorBufferInfo>();
+					bufferInfo = &bufferInfos[i];
 					*bufferInfo = {};
 					buffer = static_cast<Buffer*>(writeInfo.buffer.buffer);
 					bufferInfo->buffer = buffer->buffer.buffer;
@@ -698,7 +823,7 @@ namespace jv::ge
 					write.pBufferInfo = bufferInfo;
 					break;
 				case BindingType::sampler:
-					imageInfo = ge.tempArena.New<VkDescriptorImageInfo>();
+					imageInfo = &imageInfos[i];
 					*imageInfo = {};
 					sampler = static_cast<Sampler*>(writeInfo.image.sampler);
 					image = static_cast<Image*>(writeInfo.image.image);
@@ -713,8 +838,7 @@ namespace jv::ge
 			}
 		}
 
-		vkUpdateDescriptorSets(ge.app.device, writes.length, writes.ptr, 0, nullptr);
-		ge.tempArena.DestroyScope(scope);
+		vkUpdateDescriptorSets(ge.app.device, info.bindingCount, writes, 0, nullptr);
 	}
 
 	void UpdateBuffer(const BufferUpdateInfo& info)
@@ -722,11 +846,39 @@ namespace jv::ge
 		assert(ge.initialized);
 		const auto buffer = static_cast<Buffer*>(info.buffer);
 
-		void* vkData;
-		const auto result = vkMapMemory(ge.app.device, buffer->buffer.memory.memory, buffer->buffer.memory.offset + info.offset, info.size, 0, &vkData);
+		assert(buffer->buffer.memory.mapped);
+		memcpy(static_cast<char*>(buffer->buffer.memory.mapped) + info.offset, info.data, info.size);
+	}
+
+	BufferSlice GetBufferSlice(const Resource buffer, const uint32_t frameIndex)
+	{
+		assert(ge.initialized);
+		const auto pBuffer = static_cast<Buffer*>(buffer);
+		assert(pBuffer->info.dynamic);
+		assert(frameIndex < GetFrameCount());
+
+		BufferSlice slice{};
+		slice.offset = pBuffer->sliceStride * frameIndex;
+		slice.size = pBuffer->info.size;
+		slice.data = static_cast<char*>(pBuffer->buffer.memory.mapped) + slice.offset;
+		return slice;
+	}
+
+	void FlushBufferSlice(const Resource buffer, const BufferSlice& slice)
+	{
+		assert(ge.initialized);
+		const auto pBuffer = static_cast<Buffer*>(buffer);
+		if (pBuffer->coherent)
+			return;
+
+		// The slice stride is a multiple of the non coherent atom size, so the range never reaches another allocation.
+		VkMappedMemoryRange range{};
+		range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+		range.memory = pBuffer->buffer.memory.memory;
+		range.offset = pBuffer->buffer.memory.offset + slice.offset;
+		range.size = pBuffer->sliceStride;
+		const auto result = vkFlushMappedMemoryRanges(ge.app.device, 1, &range);
 		assert(!result);
-		memcpy(vkData, info.data, info.size);
-		vkUnmapMemory(ge.app.device, buffer->buffer.memory.memory);
 	}
 
 	Resource CreateShader(const ShaderCreateInfo& info)
@@ -922,7 +1074,7 @@ namespace jv::ge
 	Resource CreatePipeline(const PipelineCreateInfo& info)
 	{
 		assert(ge.initialized);
-		auto& pipeline = Add(ge.arena, ge.pipelines);
+		auto& pipeline = Add(ge.pipelinePool, ge.pipelines);
 		pipeline.layouts = CreateArray<VkDescriptorSetLayout>(ge.arena, info.layoutCount);
 
 		for (uint32_t i = 0; i < info.layoutCount; ++i)
@@ -1008,13 +1160,91 @@ namespace jv::ge
 		}
 
 		pipeline.pipeline = vk::Pipeline::Create(pipelineCreateInfo, ge.tempArena, ge.app);
+		pipeline.renderPass = pipelineCreateInfo.renderPass;
 		return &pipeline;
 	}
 
+	void DrawInstances(const DrawInfo& info, VkCommandBuffer cmd);
+
 	void Draw(const DrawInfo& info)
 	{
 		assert(ge.initialized);
-		Add(ge.frameArena, ge.draws) = info;
+
+		if (!activeDrawBatch)
+		{
+			Add(ge.frameArena, ge.draws) = info;
+			return;
+		}
+
+		// The secondary command buffer can only be started once the render pass is known.
+		auto& batch = *activeDrawBatch;
+		const auto pipeline = static_cast<Pipeline*>(info.pipeline);
+		if (!batch.renderPass)
+		{
+			batch.renderPass = pipeline->renderPass;
+
+			VkCommandBufferInheritanceInfo inheritanceInfo{};
+			inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+			inheritanceInfo.renderPass = batch.renderPass;
+			inheritanceInfo.subpass = 0;
+
+			VkCommandBufferBeginInfo cmdBufferBeginInfo{};
+			cmdBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+			cmdBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+			cmdBufferBeginInfo.pInheritanceInfo = &inheritanceInfo;
+			const auto result = vkBeginCommandBuffer(batch.cmd, &cmdBufferBeginInfo);
+			assert(!result);
+		}
+
+		assert(batch.renderPass == pipeline->renderPass);
+		DrawInstances(info, batch.cmd);
+	}
+
+	void BeginDrawBatch(const uint32_t threadIndex, const uint32_t order)
+	{
+		assert(ge.initialized);
+		assert(!activeDrawBatch);
+		assert(threadIndex < ge.drawBatchThreadCount);
+
+		auto& pool = ge.drawBatchPools[ge.swapChain.GetIndex() * ge.drawBatchThreadCount + threadIndex];
+		assert(pool.count < ge.drawBatchCapacity);
+
+		if (pool.count == pool.allocatedCount)
+		{
+			VkCommandBufferAllocateInfo cmdBufferAllocInfo{};
+			cmdBufferAllocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			cmdBufferAllocInfo.commandPool = pool.commandPool;
+			cmdBufferAllocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+			cmdBufferAllocInfo.commandBufferCount = 1;
+
+			const auto result = vkAllocateCommandBuffers(ge.app.device, &cmdBufferAllocInfo, &pool.cmdBuffers[pool.allocatedCount++]);
+			assert(!result);
+		}
+
+		auto& batch = pool.batches[pool.count];
+		batch.cmd = pool.cmdBuffers[pool.count++];
+		batch.renderPass = VK_NULL_HANDLE;
+		batch.order = order;
+		batch.executed = false;
+		activeDrawBatch = &batch;
+	}
+
+	void EndDrawBatch()
+	{
+		assert(activeDrawBatch);
+		if (activeDrawBatch->renderPass)
+		{
+			const auto result = vkEndCommandBuffer(activeDrawBatch->cmd);
+			assert(!result);
+		}
+		activeDrawBatch = nullptr;
+	}
+
+	void SetRenderFrameThreadIndex(const uint32_t threadIndex)
+	{
+		assert(ge.initialized);
+		assert(threadIndex < ge.drawBatchThreadCount);
+		renderFrameThreadIndex = threadIndex;
 	}
 
 	void DestroyScenes()
@@ -1025,9 +1255,16 @@ namespace jv::ge
 		for (uint32_t i = 0; i < length; ++i)
 		{
 			auto& scene = ge.scenes[i];
+			if (ge.trackArenaStats)
+				scene.freeArena.GetStats().Print();
 			ClearScene(&scene);
 
-			vk::FreeArena::Destroy(scene.arena, ge.app, scene.freeArena);
+			if (ge.trackArenaStats)
+				scene.arenaStats.Print();
+
+			vk::FreeArena::Destroy(scene.memoryArena, ge.app, scene.freeArena);
+			Arena::Destroy(scene.memoryArena);
+			free(scene.memoryArenaMem);
 			Arena::Destroy(scene.arena);
 			free(scene.arenaMem);
 		}
@@ -1061,28 +1298,111 @@ namespace jv::ge
 
 		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->pipeline.layout,
 		                        0, info.descriptorSetCount, descriptorSets, 0, nullptr);
-		mesh->mesh.Draw(ge.tempArena, cmd, info.instanceCount);
+		mesh->mesh.Draw(cmd, info.instanceCount);
 	}
 
-	bool WaitForImage()
+	// Returns the command buffers of the draw batches for this render pass that haven't been executed yet, sorted by their order.
+	// Batches that were recorded for another render pass are left for the frame that renders with it.
+	Array<VkCommandBuffer> CollectDrawBatches(Arena& arena, const VkRenderPass renderPass)
+	{
+		const auto& draws = ge.draws;
+		const uint32_t poolOffset = ge.swapChain.GetIndex() * ge.drawBatchThreadCount;
+
+		// Batches without draw calls were never started, so they don't match any render pass.
+		uint32_t count = 0;
+		for (uint32_t i = 0; i < ge.drawBatchThreadCount; ++i)
+		{
+			const auto& pool = ge.drawBatchPools[poolOffset + i];
+			for (uint32_t j = 0; j < pool.count; ++j)
+				count += !pool.batches[j].executed && pool.batches[j].renderPass == renderPass;
+		}
+		if (count == 0)
+			return {};
+
+		// Unbatched draws can't be recorded inline in a render pass that executes secondary command buffers.
+		if (draws.GetCount() > 0)
+		{
+			BeginDrawBatch(renderFrameThreadIndex, UINT32_MAX);
+			for (const auto& draw : ToArray(ge.frameArena, draws, false))
+				Draw(draw);
+			EndDrawBatch();
+			++count;
+		}
+
+		const auto batches = CreateArray<DrawBatch*>(arena, count);
+		uint32_t index = 0;
+		for (uint32_t i = 0; i < ge.drawBatchThreadCount; ++i)
+		{
+			auto& pool = ge.drawBatchPools[poolOffset + i];
+			for (uint32_t j = 0; j < pool.count; ++j)
+			{
+				auto& batch = pool.batches[j];
+				if (batch.executed || batch.renderPass != renderPass)
+					continue;
+				batch.executed = true;
+
+				uint32_t k = index++;
+				for (; k > 0 && batches[k - 1]->order > batch.order; --k)
+					batches[k] = batches[k - 1];
+				batches[k] = &batch;
+			}
+		}
+
+		const auto cmdBuffers = CreateArray<VkCommandBuffer>(arena, index);
+		for (uint32_t i = 0; i < index; ++i)
+			cmdBuffers[i] = batches[i]->cmd;
+		return cmdBuffers;
+	}
+
+	bool PollEvents()
+	{
+		assert(ge.initialized);
+		return ge.glfwApp.BeginFrame();
+	}
+
+	bool WaitForImage(const bool pollEvents)
 	{
 		assert(!ge.waitedForImage);
-		if (!ge.glfwApp.BeginFrame())
+		if (pollEvents && !PollEvents())
 			return false;
 		ge.swapChain.WaitForImage(ge.app);
 		ge.waitedForImage = true;
+
+		// The previous frame that used these command buffers has finished.
+		for (uint32_t i = 0; i < ge.drawBatchThreadCount; ++i)
+		{
+			auto& pool = ge.drawBatchPools[ge.swapChain.GetIndex() * ge.drawBatchThreadCount + i];
+			if (pool.count == 0)
+				continue;
+			const auto result = vkResetCommandPool(ge.app.device, pool.commandPool, 0);
+			assert(!result);
+			pool.count = 0;
+		}
 		return true;
 	}
 
+	void FlushUploads()
+	{
+		assert(ge.initialized);
+		ge.stagingRing.Flush(ge.app);
+	}
+
 	bool RenderFrame(const RenderFrameInfo& info)
 	{
 		assert(ge.initialized);
 
+		// Submitted before the frame on the same queue, so the uploads are finished before they're used.
+		ge.stagingRing.Flush(ge.app);
+
 		if (!ge.waitedForImage)
 			if (!WaitForImage())
 				return false;
 
-		const auto draws = ToArray(ge.frameArena, ge.draws, false);
+		const auto renderPass = info.frameBuffer ?
+			static_cast<FrameBuffer*>(info.frameBuffer)->renderPass->renderPass : ge.swapChain.GetRenderPass();
+		const auto batches = CollectDrawBatches(ge.frameArena, renderPass);
+		const auto draws = batches.length > 0 ? Array<DrawInfo>() : ToArray(ge.frameArena, ge.draws, false);
+		const auto contents = batches.length > 0 ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE;
 		const auto waitSemaphores = CreateArray<VkSemaphore>(ge.tempArena, info.waitSemaphoreCount);
 		for (uint32_t i = 0; i < info.waitSemaphoreCount; ++i)
 			waitSemaphores[i] = static_cast<Semaphore*>(info.waitSemaphores[i])->semaphore;
@@ -1135,10 +1455,12 @@ namespace jv::ge
 			renderPassBeginInfo.clearValueCount = 1;
 			renderPassBeginInfo.pClearValues = &clearColor;
 
-			vkCmdBeginRenderPass(cmd, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+			vkCmdBeginRenderPass(cmd, &renderPassBeginInfo, contents);
 
 			for (auto& draw : draws)
 				DrawInstances(draw, cmd);
+			if (batches.length > 0)
+				vkCmdExecuteCommands(cmd, batches.length, batches.ptr);
 
 			vkCmdEndRenderPass(cmd);
 
@@ -1167,9 +1489,11 @@ namespace jv::ge
 		}
 		else
 		{
-			const auto cmd = ge.swapChain.BeginFrame(ge.app, true);
+			const auto cmd = ge.swapChain.BeginFrame(ge.app, true, contents);
 			for (auto& draw : draws)
 				DrawInstances(draw, cmd);
+			if (batches.length > 0)
+				vkCmdExecuteCommands(cmd, batches.length, batches.ptr);
 			
 			ge.swapChain.EndFrame(ge.tempArena, ge.app, waitSemaphores);
 			ge.waitedForImage = false;
@@ -1178,6 +1502,15 @@ namespace jv::ge
 
 		ge.frameArena.Clear();
 		ge.draws = {};
+
+		if (ge.trackArenaStats)
+		{
+			ge.arenaStats.EndFrame();
+			ge.tempArenaStats.EndFrame();
+			ge.frameArenaStats.EndFrame();
+			for (auto& scene : ge.scenes)
+				scene.arenaStats.EndFrame();
+		}
 		return true;
 	}
 
@@ -1209,6 +1542,115 @@ namespace jv::ge
 		assert(!result);
 	}
 
+	MemoryStats GetMemoryStats()
+	{
+		assert(ge.initialized);
+
+		VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{};
+		budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+		VkPhysicalDeviceMemoryProperties2 memProperties{};
+		memProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+		memProperties.pNext = ge.app.memoryBudget ? &budgetProperties : nullptr;
+		vkGetPhysicalDeviceMemoryProperties2(ge.app.physicalDevice, &memProperties);
+		const auto& properties = memProperties.memoryProperties;
+
+		MemoryStats stats{};
+		stats.heapCount = properties.memoryHeapCount;
+		stats.budgetSupported = ge.app.memoryBudget;
+
+		for (uint32_t i = 0; i < properties.memoryHeapCount; ++i)
+		{
+			auto& heap = stats.heaps[i];
+			heap.size = properties.memoryHeaps[i].size;
+			heap.deviceLocal = properties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT;
+			heap.usage = ge.app.memoryBudget ? budgetProperties.heapUsage[i] : 0;
+			heap.budget = ge.app.memoryBudget ? budgetProperties.heapBudget[i] : heap.size;
+		}
+
+		// Pools are indexed by memory type.
+		for (const auto& scene : ge.scenes)
+			for (uint32_t i = 0; i < scene.freeArena.pools.length; ++i)
+			{
+				const auto& pool = scene.freeArena.pools[i];
+				auto& heap = stats.heaps[properties.memoryTypes[i].heapIndex];
+				for (uint32_t j = 0; j < pool.pageCount; ++j)
+					heap.reserved += pool.pages[j].size;
+			}
+
+		if (!ge.app.memoryBudget)
+			for (uint32_t i = 0; i < stats.heapCount; ++i)
+				stats.heaps[i].usage = stats.heaps[i].reserved;
+		return stats;
+	}
+
+	SceneMemoryStats GetSceneMemoryStats(const Resource scene)
+	{
+		assert(ge.initialized);
+		const auto pScene = static_cast<Scene*>(scene);
+
+		const auto freeArenaStats = pScene->freeArena.GetStats();
+		SceneMemoryStats stats{};
+		stats.reserved = freeArenaStats.reservedSize;
+		stats.used = freeArenaStats.usedSize;
+
+		for (const auto& allocation : pScene->allocations)
+		{
+			switch (allocation.type)
+			{
+			case Allocation::Type::image:
+				stats.imageMemory += allocation.image.image.memory.size;
+				++stats.imageCount;
+				break;
+			case Allocation::Type::mesh:
+				stats.meshMemory += allocation.mesh.mesh.indexBuffer.memory.size;
+				for (const auto& vertexBuffer : allocation.mesh.mesh.vertexBuffers)
+					stats.meshMemory += vertexBuffer.memory.size;
+				++stats.meshCount;
+				break;
+			case Allocation::Type::buffer:
+				stats.bufferMemory += allocation.buffer.buffer.memory.size;
+				++stats.bufferCount;
+				break;
+			case Allocation::Type::sampler:
+				++stats.samplerCount;
+				break;
+			case Allocation::Type::pool:
+				++stats.poolCount;
+				break;
+			default:
+				std::cerr << "Allocation type not supported." << std::endl;
+			}
+		}
+
+		return stats;
+	}
+
+	void PrintMemoryStats()
+	{
+		assert(ge.initialized);
+		GetMemoryStats().Print();
+		for (auto& scene : ge.scenes)
+			GetSceneMemoryStats(&scene).Print();
+	}
+
+	void MemoryStats::Print() const
+	{
+		for (uint32_t i = 0; i < heapCount; ++i)
+		{
+			const auto& heap = heaps[i];
+			std::cout << "[Memory heap " << i << (heap.deviceLocal ? ", device local" : "") << "] size: " << heap.size <<
+				" B, usage: " << heap.usage << " B, budget: " << heap.budget << " B, reserved by scenes: " << heap.reserved << " B" <<
+				(budgetSupported ? "" : " (no budget extension)") << std::endl;
+		}
+	}
+
+	void SceneMemoryStats::Print() const
+	{
+		std::cout << "[Scene memory] reserved: " << reserved << " B, used: " << used << " B, images: " << imageCount << 
+			" (" << imageMemory << " B), meshes: " << meshCount << " (" << meshMemory << " B), buffers: " << bufferCount << 
+			" (" << bufferMemory << " B), samplers: " << samplerCount << ", descriptor pools: " << poolCount << std::endl;
+	}
+
 	void Shutdown()
 	{
 		assert(ge.initialized);
@@ -1216,9 +1658,19 @@ namespace jv::ge
 		const auto result = vkDeviceWaitIdle(ge.app.device);
 		assert(!result);
 
+		// Reports what the scenes still hold before they are cleared.
+		if (ge.trackArenaStats)
+			PrintMemoryStats();
 		DestroyScenes();
 
 		ge.arena.DestroyScope(ge.scope);
+		ge.stagingRing.Wait(ge.app);
+		vk::StagingRing::Destroy(ge.arena, ge.app, ge.stagingRing);
+		for (const auto& pool : ge.drawBatchPools)
+			vkDestroyCommandPool(ge.app.device, pool.commandPool, nullptr);
+		ge.arena.Free(ge.drawBatchPools[0].batches);
+		ge.arena.Free(ge.drawBatchPools[0].cmdBuffers);
+		DestroyArray(ge.arena, ge.drawBatchPools);
 		DestroyArray(ge.arena, ge.cmdPools);
 		vk::SwapChain::Destroy(ge.arena, ge.app, ge.swapChain);
 
@@ -1247,6 +1699,14 @@ namespace jv::ge
 
 		vk::init::DestroyApp(ge.app);
 		vk::GLFWApp::Destroy(ge.glfwApp);
+
+		if (ge.trackArenaStats)
+		{
+			ge.arenaStats.Print();
+			ge.tempArenaStats.Print();
+			ge.frameArenaStats.Print();
+		}
+
 		Arena::Destroy(ge.frameArena);
 		Arena::Destroy(ge.tempArena);
 		Arena::Destroy(ge.arena);
@@ -4,9 +4,23 @@
 
 namespace jv
 {
+	void ArenaStats::EndFrame()
+	{
+		lastFramePeakBytes = framePeakBytes;
+		framePeakBytes = usedBytes;
+	}
+
+	void ArenaStats::Print() const
+	{
+		std::cout << "[" << name << "] used: " << usedBytes << " B, peak: " << peakBytes <<
+			" B, last frame peak: " << lastFramePeakBytes << " B, overflow chunks: " << overflowChunkCount <<
+			", scopes: " << scopeCount << ", reclaimed by scopes: " << scopeReclaimedBytes << " B" << std::endl;
+	}
+
 	Arena Arena::Create(const ArenaCreateInfo& info)
 	{
 		assert(info.memorySize > sizeof(Arena) + sizeof(ArenaAllocMetaData));
+		assert(info.memorySize % alignof(Arena) == 0);
 		assert(info.alloc);
 		assert(info.free);
 
@@ -24,93 +38,150 @@ namespace jv
 			arena.info.free(arena.memory);
 	}
 
-	void* Arena::Alloc(uint32_t size)
+	uint32_t GetPadding(const Arena& chunk, const uint32_t alignment)
 	{
-		bool goNext = false;
-		auto n = next;
-		while(n)
-		{
-			goNext = goNext ? true : n->front > 0;
-			n = n->next;
-		}
-		if (goNext)
-			return next->Alloc(size);
+		const auto address = reinterpret_cast<uintptr_t>(&static_cast<char*>(chunk.memory)[chunk.front]);
+		return static_cast<uint32_t>(-address & (alignment - 1));
+	}
 
+	void* Arena::Alloc(uint32_t size, const uint32_t alignment)
+	{
+		assert(alignment > 0 && (alignment & (alignment - 1)) == 0);
 		size += (4 - size) % 4;
 
-		if (front + size + sizeof(ArenaAllocMetaData) > info.memorySize - sizeof(Arena))
+		Arena* current = tail ? tail : this;
+		uint32_t padding = GetPadding(*current, alignment);
+
+		while (current->front + padding + size + sizeof(ArenaAllocMetaData) > current->info.memorySize - sizeof(Arena))
 		{
-			if (!next)
+			if (!current->next)
 			{
-				const auto nextPtr = &static_cast<char*>(memory)[info.memorySize - sizeof(Arena)];
-				next = reinterpret_cast<Arena*>(nextPtr);
+				const auto nextPtr = &static_cast<char*>(current->memory)[current->info.memorySize - sizeof(Arena)];
+				current->next = reinterpret_cast<Arena*>(nextPtr);
 				ArenaCreateInfo createInfo = info;
 				createInfo.memory = nullptr;
-				createInfo.memorySize = Max<uint32_t>(createInfo.memorySize, size + sizeof(ArenaAllocMetaData) + sizeof(Arena));
-				*next = Create(createInfo);
+				createInfo.stats = nullptr;
+				createInfo.memorySize = Max<uint32_t>(createInfo.memorySize,
+					size + alignment + sizeof(ArenaAllocMetaData) + sizeof(Arena));
+				// Keeps the next chunk's header aligned.
+				createInfo.memorySize += (alignof(Arena) - createInfo.memorySize % alignof(Arena)) % alignof(Arena);
+				*current->next = Create(createInfo);
+				if (info.stats)
+					++info.stats->overflowChunkCount;
 			}
 
-			return next->Alloc(size);
+			current = current->next;
+			++tailDepth;
+			padding = GetPadding(*current, alignment);
 		}
 
-		void* ptr = &static_cast<char*>(memory)[front];
-		front += size + sizeof(ArenaAllocMetaData);
-		const auto metaData = reinterpret_cast<ArenaAllocMetaData*>(&static_cast<char*>(memory)[front - sizeof(
+		tail = current == this ? nullptr : current;
+		
+		void* ptr = &static_cast<char*>(current->memory)[current->front + padding];
+		current->front += padding + size + sizeof(ArenaAllocMetaData);
+		const auto metaData = reinterpret_cast<ArenaAllocMetaData*>(&static_cast<char*>(current->memory)[current->front - sizeof(
 			ArenaAllocMetaData)]);
 		*metaData = ArenaAllocMetaData();
 		metaData->size = size;
+		metaData->padding = padding;
 
-#ifdef _DEBUG
-		const Arena* current = next;
-		while (current)
+		if (info.stats)
 		{
-			assert(current->front == 0);
-			current = current->next;
+			auto& stats = *info.stats;
+			stats.usedBytes += padding + size + sizeof(ArenaAllocMetaData);
+			stats.peakBytes = Max(stats.peakBytes, stats.usedBytes);
+			stats.framePeakBytes = Max(stats.framePeakBytes, stats.usedBytes);
 		}
-#endif
 
+		assert(!current->next || current->next->front == 0);
 		return ptr;
 	}
 
 	void Arena::Free(const void* ptr)
 	{
-		const Arena* current = this;
-		while(current)
+		Arena* current = tail ? tail : this;
+
+		// Step back over chunks that have been emptied.
+		while (current != this && current->front == 0)
 		{
-			if (current->front == 0)
-				break;
+			Arena* previous = this;
+			while (previous->next != current)
+				previous = previous->next;
+			current = previous;
+			--tailDepth;
+		}
+
+		tail = current == this ? nullptr : current;
 
-			const auto metaData = reinterpret_cast<ArenaAllocMetaData*>(&static_cast<char*>(memory)[front - sizeof(ArenaAllocMetaData)]);
-			const auto frontPtr = &static_cast<char*>(memory)[front - sizeof(ArenaAllocMetaData) - metaData->size];
+		if (current->front > 0)
+		{
+			const auto metaData = reinterpret_cast<ArenaAllocMetaData*>(&static_cast<char*>(current->memory)[current->front - sizeof(ArenaAllocMetaData)]);
+			const auto frontPtr = &static_cast<char*>(current->memory)[current->front - sizeof(ArenaAllocMetaData) - metaData->size];
 
 			if (frontPtr == ptr)
 			{
-				front -= metaData->size + sizeof(ArenaAllocMetaData);
-
-#ifdef _DEBUG
-				current = current->next;
-				while(current)
-				{
-					assert(current->front == 0);
-					current = current->next;
-				}
-#endif
+				const uint32_t size = metaData->padding + metaData->size + sizeof(ArenaAllocMetaData);
+				current->front -= size;
+				if (info.stats)
+					info.stats->usedBytes -= size;
 				return;
 			}
-			
-			current = current->next;
 		}
 
 		throw std::exception("Pointer not in front of this arena.");
 	}
 
+	bool Arena::TryResize(const void* ptr, uint32_t size)
+	{
+		Arena& current = tail ? *tail : *this;
+		if (current.front == 0)
+			return false;
+
+		const auto metaData = reinterpret_cast<ArenaAllocMetaData*>(&static_cast<char*>(current.memory)[current.front - sizeof(ArenaAllocMetaData)]);
+		const uint32_t start = current.front - sizeof(ArenaAllocMetaData) - metaData->size;
+		if (&static_cast<char*>(current.memory)[start] != ptr)
+			return false;
+
+		size += (4 - size) % 4;
+		if (start + size + sizeof(ArenaAllocMetaData) > current.info.memorySize - sizeof(Arena))
+			return false;
+
+		const uint32_t oldSize = metaData->size;
+		const uint32_t padding = metaData->padding;
+		current.front = start + size + sizeof(ArenaAllocMetaData);
+		const auto newMetaData = reinterpret_cast<ArenaAllocMetaData*>(&static_cast<char*>(current.memory)[current.front - sizeof(ArenaAllocMetaData)]);
+		newMetaData->size = size;
+		newMetaData->padding = padding;
+
+		if (info.stats)
+		{
+			auto& stats = *info.stats;
+			stats.usedBytes = stats.usedBytes + size - oldSize;
+			stats.peakBytes = Max(stats.peakBytes, stats.usedBytes);
+			stats.framePeakBytes = Max(stats.framePeakBytes, stats.usedBytes);
+		}
+		return true;
+	}
+
 	void Arena::Clear()
 	{
 		front = 0;
+		if (info.stats)
+			info.stats->usedBytes = 0;
+		tail = nullptr;
+		tailDepth = 0;
 		if (next)
 			next->Clear();
 	}
 
+	void Arena::Reset()
+	{
+		if (next)
+			Destroy(*next);
+		next = nullptr;
+		Clear();
+	}
+
 	uint32_t Arena::GetTotalUsedMemory() const
 	{
 		uint32_t size = 0;
@@ -118,24 +189,18 @@ namespace jv
 		const Arena* current = this;
 		while (current)
 		{
-			++size;
+			size += current->front;
 			current = current->next;
 		}
-		return size * info.memorySize;
+		return size;
 	}
 
 	uint64_t Arena::CreateScope() const
 	{
-		const Arena* current = this;
-		uint32_t depth = 0;
-		while (current->next && current->next->front > 0)
-		{
-			current = current->next;
-			++depth;
-		}
+		const Arena* current = tail ? tail : this;
 
 		Scope scope{};
-		scope.unpacked.depth = depth;
+		scope.unpacked.depth = tailDepth;
 		scope.unpacked.front = current->front;
 		return scope.handle;
 	}
@@ -151,5 +216,17 @@ namespace jv
 		if (current->next)
 			current->next->Clear();
 		current->front = scope.unpacked.front;
+		tail = current == this ? nullptr : current;
+		tailDepth = scope.unpacked.depth;
+
+		if (info.stats)
+		{
+			auto& stats = *info.stats;
+			const uint32_t usedBytes = GetTotalUsedMemory();
+			stats.lastScopeReclaimedBytes = stats.usedBytes - usedBytes;
+			stats.scopeReclaimedBytes += stats.lastScopeReclaimedBytes;
+			stats.usedBytes = usedBytes;
+			++stats.scopeCount;
+		}
 	}
 }
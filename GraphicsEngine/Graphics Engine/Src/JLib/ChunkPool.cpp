@@ -0,0 +1,76 @@
+﻿#include "pch.h"
+#include "JLib/ChunkPool.h"
+
+namespace jv
+{
+	uint64_t PackHead(const uint64_t tag, const uint32_t index)
+	{
+		return tag << 32 | index;
+	}
+
+	ChunkPool ChunkPool::Create(Arena& arena, const ChunkPoolCreateInfo& info)
+	{
+		assert(info.alloc);
+		assert(info.free);
+		assert(info.chunkSize > 0);
+		assert(info.chunkCount > 0 && info.chunkCount < UINT32_MAX);
+
+		ChunkPool chunkPool{};
+		chunkPool.info = info;
+		chunkPool.memory = static_cast<char*>(info.alloc(info.chunkSize * info.chunkCount));
+		chunkPool.next = arena.New<std::atomic<uint32_t>>(info.chunkCount);
+		chunkPool.head = arena.New<std::atomic<uint64_t>>();
+
+		for (uint32_t i = 0; i < info.chunkCount; ++i)
+			chunkPool.next[i].store(i + 1 == info.chunkCount ? UINT32_MAX : i + 1, std::memory_order_relaxed);
+		chunkPool.head->store(PackHead(0, 0), std::memory_order_release);
+		return chunkPool;
+	}
+
+	void ChunkPool::Destroy(const ChunkPool& chunkPool)
+	{
+		chunkPool.info.free(chunkPool.memory);
+	}
+
+	void* ChunkPool::Alloc(const uint32_t size) const
+	{
+		if (size > info.chunkSize)
+			return info.alloc(size);
+
+		uint64_t current = head->load(std::memory_order_acquire);
+		while (true)
+		{
+			const auto index = static_cast<uint32_t>(current);
+			if (index == UINT32_MAX)
+				return info.alloc(size);
+
+			const uint64_t desired = PackHead((current >> 32) + 1, next[index].load(std::memory_order_relaxed));
+			if (head->compare_exchange_weak(current, desired, std::memory_order_acquire, std::memory_order_acquire))
+				return &memory[static_cast<size_t>(index) * info.chunkSize];
+		}
+	}
+
+	void ChunkPool::Free(void* ptr) const
+	{
+		if (!Owns(ptr))
+		{
+			info.free(ptr);
+			return;
+		}
+
+		const auto index = static_cast<uint32_t>((static_cast<char*>(ptr) - memory) / info.chunkSize);
+		uint64_t current = head->load(std::memory_order_relaxed);
+		uint64_t desired;
+		do
+		{
+			next[index].store(static_cast<uint32_t>(current), std::memory_order_relaxed);
+			desired = PackHead((current >> 32) + 1, index);
+		} while (!head->compare_exchange_weak(current, desired, std::memory_order_release, std::memory_order_relaxed));
+	}
+
+	bool ChunkPool::Owns(const void* ptr) const
+	{
+		const auto bytes = static_cast<const char*>(ptr);
+		return bytes >= memory && bytes < memory + static_cast<size_t>(info.chunkSize) * info.chunkCount;
+	}
+}
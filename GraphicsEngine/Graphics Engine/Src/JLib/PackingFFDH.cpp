@@ -2,7 +2,7 @@
 #include "Jlib/PackingFFDH.h"
 
 #include "JLib/ArrayUtils.h"
-#include "JLib/LinearSort.h"
+#include "JLib/Sort.h"
 #include "JLib/VectorUtils.h"
 
 namespace jv
@@ -14,10 +14,14 @@ namespace jv
 		uint32_t index;
 	};
 
-	bool RefSorter(Ref& a, Ref& b)
+	struct RefSorter final
 	{
-		return a.length > b.length;
-	}
+		bool operator()(const Ref& a, const Ref& b) const
+		{
+			// Ties are broken by index to keep the packing deterministic.
+			return a.length > b.length || (a.length == b.length && a.index < b.index);
+		}
+	};
 
 	Array<glm::ivec2> Pack(Arena& arena, Arena& tempArena, const Array<glm::ivec2>& shapes, glm::ivec2& outArea)
 	{
@@ -44,7 +48,7 @@ namespace jv
 		}
 
 		// Sort from largest to smallest.
-		LinearSort(refs.ptr, length, RefSorter);
+		IntroSort(refs.ptr, length, RefSorter());
 
 		glm::ivec2 area{ 32 };
 		while (true)
@@ -1,15 +1,154 @@
 ﻿#include "pch.h"
 #include "Vk/VkFreeArena.h"
 #include "JLib/ArrayUtils.h"
-#include "JLib/LinkedListUtils.h"
 #include "JLib/Math.h"
+#include "JLib/Sort.h"
+#include "JLib/VectorUtils.h"
 #include "Vk/VkApp.h"
 #include "Vk/VkMemory.h"
+#include <intrin.h>
 #include <iostream>
-#include <bitset>
 
 namespace jv::vk
 {
+	// Every block starts and ends on this boundary, which also keeps the first level above the second level's bit count.
+	constexpr VkDeviceSize MIN_BLOCK_SIZE = 16;
+	constexpr uint32_t SL_LOG2 = 3;
+	constexpr uint32_t SL_COUNT = 1 << SL_LOG2;
+	constexpr uint32_t FL_COUNT = 32;
+
+	uint32_t FindFirstSet(const uint32_t mask)
+	{
+		unsigned long index;
+		_BitScanForward(&index, mask);
+		return index;
+	}
+
+	uint32_t FindLastSet(const VkDeviceSize value)
+	{
+		unsigned long index;
+		_BitScanReverse64(&index, value);
+		return index;
+	}
+
+	VkDeviceSize AlignUp(const VkDeviceSize size, const VkDeviceSize alignment)
+	{
+		return (size + alignment - 1) & ~(alignment - 1);
+	}
+
+	// Returns the size class of a block.
+	void MapInsert(const VkDeviceSize size, uint32_t& fl, uint32_t& sl)
+	{
+		fl = FindLastSet(size);
+		sl = static_cast<uint32_t>(size >> (fl - SL_LOG2)) ^ SL_COUNT;
+	}
+
+	// Rounds up to the next size class, so that every block in the returned class is large enough.
+	void MapSearch(VkDeviceSize size, uint32_t& fl, uint32_t& sl)
+	{
+		size += (static_cast<VkDeviceSize>(1) << (FindLastSet(size) - SL_LOG2)) - 1;
+		MapInsert(size, fl, sl);
+	}
+
+	void InsertFreeBlock(FreeArena::Pool& pool, FreeArena::Block* block)
+	{
+		uint32_t fl, sl;
+		MapInsert(block->size, fl, sl);
+		assert(fl < FL_COUNT);
+
+		auto& head = pool.freeLists[fl * SL_COUNT + sl];
+		block->free = true;
+		block->prevFree = nullptr;
+		block->nextFree = head;
+		if (head)
+			head->prevFree = block;
+		head = block;
+
+		pool.flBitmap |= 1u << fl;
+		pool.slBitmaps[fl] |= 1u << sl;
+	}
+
+	void RemoveFreeBlock(FreeArena::Pool& pool, FreeArena::Block* block)
+	{
+		uint32_t fl, sl;
+		MapInsert(block->size, fl, sl);
+
+		if (block->prevFree)
+			block->prevFree->nextFree = block->nextFree;
+		if (block->nextFree)
+			block->nextFree->prevFree = block->prevFree;
+
+		auto& head = pool.freeLists[fl * SL_COUNT + sl];
+		if (head == block)
+		{
+			head = block->nextFree;
+			if (!head)
+			{
+				pool.slBitmaps[fl] &= ~(1u << sl);
+				if (!pool.slBitmaps[fl])
+					pool.flBitmap &= ~(1u << fl);
+			}
+		}
+
+		block->free = false;
+	}
+
+	FreeArena::Block* FindFreeBlock(const FreeArena::Pool& pool, const VkDeviceSize size)
+	{
+		if (!pool.freeLists)
+			return nullptr;
+
+		uint32_t fl, sl;
+		MapSearch(size, fl, sl);
+		if (fl >= FL_COUNT)
+			return nullptr;
+
+		uint32_t slMap = pool.slBitmaps[fl] & (~0u << sl);
+		if (!slMap)
+		{
+			// Look for the smallest first level that is larger.
+			const uint32_t flMap = fl + 1 < FL_COUNT ? pool.flBitmap & ~0u << (fl + 1) : 0;
+			if (!flMap)
+				return nullptr;
+			fl = FindFirstSet(flMap);
+			slMap = pool.slBitmaps[fl];
+		}
+
+		sl = FindFirstSet(slMap);
+		return pool.freeLists[fl * SL_COUNT + sl];
+	}
+
+	FreeArena::Block* NewBlock(const FreeArena& freeArena)
+	{
+		auto& table = *freeArena.blocks;
+		FreeArena::Block* block = table.unused;
+		if (block)
+			table.unused = block->nextFree;
+		else
+		{
+			const uint32_t chunkIndex = table.count / FreeArena::BLOCK_CHUNK_LENGTH;
+			assert(chunkIndex < FreeArena::MAX_BLOCK_CHUNK_COUNT);
+			auto& chunk = table.chunks[chunkIndex];
+			if (!chunk)
+				chunk = freeArena.arena->New<FreeArena::Block>(FreeArena::BLOCK_CHUNK_LENGTH);
+			block = &chunk[table.count % FreeArena::BLOCK_CHUNK_LENGTH];
+			block->index = table.count++;
+		}
+
+		const uint32_t index = block->index;
+		*block = {};
+		block->index = index;
+		return block;
+	}
+
+	void DeleteBlock(const FreeArena& freeArena, FreeArena::Block* block)
+	{
+		auto& table = *freeArena.blocks;
+		block->page = nullptr;
+		block->nextFree = table.unused;
+		table.unused = block;
+	}
+
 	uint32_t GetPoolId(const FreeArena& arena, const uint32_t typeFilter, const VkMemoryPropertyFlags properties)
 	{
 		uint32_t id = 0;
@@ -20,25 +159,119 @@ namespace jv::vk
 				return id;
 			++id;
 		}
-
-		std::bitset<sizeof(properties)> propbits(properties);
-		std::bitset < sizeof (typeFilter) > typebits(typeFilter);
-		//std::cout << "GetPoolId fail: ";
-		//std::cout << propbits << " " << typebits << "\n";
 		return UINT32_MAX;
 	}
 
-	VkDeviceSize CalculateBufferSize(const VkDeviceSize size, const VkDeviceSize alignment)
+	FreeArena::Page* AddPage(const FreeArena& freeArena, const App& app, const uint32_t poolId, const VkDeviceSize minSize)
+	{
+		auto& pool = freeArena.pools[poolId];
+		if (!pool.pages)
+		{
+			pool.pages = freeArena.arena->New<FreeArena::Page>(FreeArena::MAX_PAGE_COUNT);
+			if (!freeArena.linear)
+			{
+				pool.slBitmaps = freeArena.arena->New<uint32_t>(FL_COUNT);
+				pool.freeLists = freeArena.arena->New<FreeArena::Block*>(FL_COUNT * SL_COUNT);
+			}
+		}
+
+		assert(pool.pageCount < FreeArena::MAX_PAGE_COUNT);
+		auto& page = pool.pages[pool.pageCount++];
+		page = {};
+		page.size = Max<VkDeviceSize>(pool.pageSize, AlignUp(minSize, MIN_BLOCK_SIZE));
+		page.poolId = poolId;
+		assert(FindLastSet(page.size) < FL_COUNT);
+
+		VkMemoryAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		allocInfo.allocationSize = page.size;
+		allocInfo.memoryTypeIndex = poolId;
+
+		auto result = vkAllocateMemory(app.device, &allocInfo, nullptr, &page.memory);
+		assert(!result);
+
+		// Host visible pages stay mapped, since device memory can only be mapped once at a time.
+		if (pool.memPropertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+		{
+			result = vkMapMemory(app.device, page.memory, 0, VK_WHOLE_SIZE, 0, &page.mapped);
+			assert(!result);
+		}
+
+		return &page;
+	}
+
+	void FreePage(const App& app, const FreeArena::Page& page)
+	{
+		if (page.mapped)
+			vkUnmapMemory(app.device, page.memory);
+		vkFreeMemory(app.device, page.memory, nullptr);
+	}
+
+	// Bumps the top of the current page, or moves on to the next page if it doesn't fit.
+	FreeArena::Page* AllocLinear(const FreeArena& freeArena, const App& app, const uint32_t poolId,
+		const VkDeviceSize size, const VkDeviceSize alignment, VkDeviceSize& outOffset)
 	{
-		return (size / alignment + (size % alignment > 0)) * alignment;
+		auto& pool = freeArena.pools[poolId];
+		outOffset = 0;
+
+		// Allocations that are larger than a page get a page of their own, preferably one that was kept.
+		if (size > pool.pageSize)
+		{
+			for (uint32_t i = 0; i < pool.pageCount; ++i)
+			{
+				auto& page = pool.pages[i];
+				if (page.allocationCount == 0 && page.size >= size)
+					return &page;
+			}
+			return AddPage(freeArena, app, poolId, size);
+		}
+
+		while (pool.currentPage < pool.pageCount)
+		{
+			auto& page = pool.pages[pool.currentPage];
+			const VkDeviceSize offset = AlignUp(page.top, alignment);
+			if (offset + size <= page.size)
+			{
+				outOffset = offset;
+				return &page;
+			}
+			// Kept pages that are too small for this allocation stay unused until the next reset.
+			if (pool.currentPage + 1 == pool.pageCount)
+				break;
+			++pool.currentPage;
+		}
+
+		const auto page = AddPage(freeArena, app, poolId, size);
+		pool.currentPage = pool.pageCount - 1;
+		return page;
 	}
 
-	FreeArena FreeArena::Create(Arena& arena, const App& app, const VkDeviceSize pageSize)
+	// Splits off the end of a used block as a new free block.
+	void SplitBlock(const FreeArena& freeArena, FreeArena::Pool& pool, FreeArena::Block* block, const VkDeviceSize size)
+	{
+		const auto remainder = NewBlock(freeArena);
+		remainder->offset = block->offset + size;
+		remainder->size = block->size - size;
+		remainder->page = block->page;
+		remainder->prev = block;
+		remainder->next = block->next;
+		if (block->next)
+			block->next->prev = remainder;
+		block->next = remainder;
+		block->size = size;
+		InsertFreeBlock(pool, remainder);
+	}
+
+	FreeArena FreeArena::Create(Arena& arena, const App& app, const VkDeviceSize pageSize, const bool linear)
 	{
-		//std::cout << "Creating Arena\n";
 		FreeArena freeArena{};
-		freeArena.pageSize = pageSize;
+		freeArena.arena = &arena;
 		freeArena.scope = arena.CreateScope();
+		freeArena.linear = linear;
+
+		VkPhysicalDeviceProperties properties;
+		vkGetPhysicalDeviceProperties(app.physicalDevice, &properties);
+		freeArena.bufferImageGranularity = Max<VkDeviceSize>(properties.limits.bufferImageGranularity, 1);
 
 		VkPhysicalDeviceMemoryProperties memProperties;
 		vkGetPhysicalDeviceMemoryProperties(app.physicalDevice, &memProperties);
@@ -49,81 +282,322 @@ namespace jv::vk
 			auto& pool = freeArena.pools[i] = {};
 			const auto& memType = memProperties.memoryTypes[i];
 			pool.memPropertyFlags = memType.propertyFlags;
-			std::bitset<sizeof(pool.memPropertyFlags) * 8> bits(pool.memPropertyFlags);
-			//std::cout << "Created pool with flags " << bits << "\n";
+			const VkDeviceSize heapSize = memProperties.memoryHeaps[memType.heapIndex].size;
+			pool.pageSize = Max(MIN_BLOCK_SIZE, Min(pageSize, heapSize / 8) & ~(MIN_BLOCK_SIZE - 1));
 		}
 
-		
+		if (!linear)
+			freeArena.blocks = arena.New<BlockTable>();
 		return freeArena;
 	}
 
 	void FreeArena::Destroy(Arena& arena, const App& app, const FreeArena& freeArena)
 	{
 		for (const auto& pool : freeArena.pools)
-			for (const auto& page : pool.pages)
-				vkFreeMemory(app.device, page.memory, nullptr);
+			for (uint32_t i = 0; i < pool.pageCount; ++i)
+				FreePage(app, pool.pages[i]);
 		arena.DestroyScope(freeArena.scope);
 	}
 
-	uint64_t FreeArena::Alloc(Arena& arena, const App& app, const VkMemoryRequirements memRequirements,
-	    const VkMemoryPropertyFlags properties,
-		const uint32_t count, Memory& outMemory) const
+	uint64_t FreeArena::Alloc(const App& app, const VkMemoryRequirements memRequirements,
+		const VkMemoryPropertyFlags properties, const uint32_t count, Memory& outMemory, const bool optimalTiling) const
 	{
 		const uint32_t poolId = GetPoolId(*this, memRequirements.memoryTypeBits, properties);
 		assert(poolId != UINT32_MAX);
-
-		const VkDeviceSize size = CalculateBufferSize(memRequirements.size * count, memRequirements.alignment);
 		auto& pool = pools[poolId];
 
-		Page* dstPage = nullptr;
-		uint32_t pageNum = 0;
-		for (auto& page : pool.pages)
+		// Giving images their own granularity sized regions keeps them from sharing one with a buffer.
+		VkDeviceSize alignment = Max(memRequirements.alignment, MIN_BLOCK_SIZE);
+		if (optimalTiling)
+			alignment = Max(alignment, bufferImageGranularity);
+		const VkDeviceSize size = AlignUp(memRequirements.size * count, alignment);
+
+		FreeMemory handle{};
+		handle.unpacked.poolId = static_cast<uint16_t>(poolId);
+
+		if (linear)
 		{
-			if (page.remaining == page.size && page.alignment == memRequirements.alignment)
-			{
-				dstPage = &page;
-				break;
-			}
+			VkDeviceSize offset;
+			const auto page = AllocLinear(*this, app, poolId, size, alignment, offset);
+			page->top = offset + size;
+			++page->allocationCount;
+
+			outMemory.memory = page->memory;
+			outMemory.offset = offset;
+			outMemory.size = size;
+			outMemory.mapped = page->mapped ? static_cast<char*>(page->mapped) + offset : nullptr;
 
-			++pageNum;
+			handle.unpacked.blockIndex = UINT32_MAX;
+			handle.unpacked.pageIndex = static_cast<uint16_t>(page - pool.pages);
+			return handle.handle;
 		}
 
-		if(!dstPage)
+		// Offsets are always a multiple of the minimum block size, so this is the most padding that can be needed.
+		const VkDeviceSize searchSize = size + alignment - MIN_BLOCK_SIZE;
+		Block* block = FindFreeBlock(pool, searchSize);
+		if (block)
+			RemoveFreeBlock(pool, block);
+		else
 		{
-			dstPage = &Insert(arena, pool.pages, 0);
-			dstPage->alignment = memRequirements.alignment;
-			dstPage->remaining = Max<VkDeviceSize>(size, pageSize);
-			dstPage->size = dstPage->remaining;
-
-			VkMemoryAllocateInfo allocInfo{};
-			allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-			allocInfo.allocationSize = dstPage->size;
-			allocInfo.memoryTypeIndex = static_cast<uint32_t>(poolId);
+			const auto page = AddPage(*this, app, poolId, searchSize);
+			block = NewBlock(*this);
+			block->offset = 0;
+			block->size = page->size;
+			block->page = page;
+		}
 
-			const auto result = vkAllocateMemory(app.device, &allocInfo, nullptr, &dstPage->memory);
-			assert(!result);
+		// Split off the padding in front as a free block. The block before it is never free, since free neighbours are merged.
+		const VkDeviceSize padding = AlignUp(block->offset, alignment) - block->offset;
+		if (padding > 0)
+		{
+			const auto front = NewBlock(*this);
+			front->offset = block->offset;
+			front->size = padding;
+			front->page = block->page;
+			front->prev = block->prev;
+			front->next = block;
+			if (block->prev)
+				block->prev->next = front;
+			block->prev = front;
+			block->offset += padding;
+			block->size -= padding;
+			InsertFreeBlock(pool, front);
 		}
 
-		outMemory.memory = dstPage->memory;
-		outMemory.offset = dstPage->size - dstPage->remaining;
-		outMemory.size = size;
+		if (block->size - size >= MIN_BLOCK_SIZE)
+			SplitBlock(*this, pool, block, size);
 
-		dstPage->remaining -= size;
+		const auto page = block->page;
+		++page->allocationCount;
 
-		FreeMemory handle{};
-		handle.unpacked.size = static_cast<uint32_t>(size);
-		handle.unpacked.pageNum = static_cast<uint16_t>(pool.pages.GetCount() - pageNum - 1);
-		handle.unpacked.poolId = static_cast<uint16_t>(poolId);
+		outMemory.memory = page->memory;
+		outMemory.offset = block->offset;
+		outMemory.size = size;
+		outMemory.mapped = page->mapped ? static_cast<char*>(page->mapped) + block->offset : nullptr;
 
+		handle.unpacked.blockIndex = block->index;
+		handle.unpacked.pageIndex = static_cast<uint16_t>(page - pool.pages);
 		return handle.handle;
 	}
 
 	void FreeArena::Free(const uint64_t handle) const
 	{
+		if (linear)
+			return;
+
 		FreeMemory memory{};
 		memory.handle = handle;
-		const auto& pool = pools[memory.unpacked.poolId];
-		auto& page = pool.pages[memory.unpacked.pageNum];
-		page.remaining += memory.unpacked.size;
+		auto& pool = pools[memory.unpacked.poolId];
+		auto& page = pool.pages[memory.unpacked.pageIndex];
+		const uint32_t blockIndex = memory.unpacked.blockIndex;
+		auto block = &blocks->chunks[blockIndex / BLOCK_CHUNK_LENGTH][blockIndex % BLOCK_CHUNK_LENGTH];
+		assert(block->page == &page && !block->free);
+		--page.allocationCount;
+
+		if (const auto prev = block->prev; prev && prev->free)
+		{
+			RemoveFreeBlock(pool, prev);
+			prev->size += block->size;
+			prev->next = block->next;
+			if (block->next)
+				block->next->prev = prev;
+			DeleteBlock(*this, block);
+			block = prev;
+		}
+
+		if (const auto next = block->next; next && next->free)
+		{
+			RemoveFreeBlock(pool, next);
+			block->size += next->size;
+			block->next = next->next;
+			if (next->next)
+				next->next->prev = block;
+			DeleteBlock(*this, next);
+		}
+
+		InsertFreeBlock(pool, block);
+	}
+
+	void FreeArena::Reset(const App& app, const bool keepPages) const
+	{
+		assert(linear);
+		for (auto& pool : pools)
+		{
+			for (uint32_t i = 0; i < pool.pageCount; ++i)
+			{
+				auto& page = pool.pages[i];
+				if (!keepPages)
+					FreePage(app, page);
+				page.top = 0;
+				page.allocationCount = 0;
+			}
+
+			if (!keepPages)
+				pool.pageCount = 0;
+			pool.currentPage = 0;
+		}
+	}
+
+	FreeArena::Stats FreeArena::GetStats() const
+	{
+		Stats stats{};
+		VkDeviceSize freeSize = 0;
+		VkDeviceSize emptySize = 0;
+		VkDeviceSize linearUsedSize = 0;
+
+		for (const auto& pool : pools)
+		{
+			for (uint32_t i = 0; i < pool.pageCount; ++i)
+			{
+				const auto& page = pool.pages[i];
+				++stats.pageCount;
+				stats.allocationCount += page.allocationCount;
+				stats.reservedSize += page.size;
+				linearUsedSize += page.top;
+				if (linear && page.allocationCount == 0)
+					++stats.emptyPageCount;
+			}
+
+			if (!pool.freeLists)
+				continue;
+			for (uint32_t i = 0; i < FL_COUNT * SL_COUNT; ++i)
+				for (auto block = pool.freeLists[i]; block; block = block->nextFree)
+				{
+					// Empty pages are not fragmented, they can be used for anything that fits.
+					if (block->size == block->page->size)
+					{
+						++stats.emptyPageCount;
+						emptySize += block->size;
+						continue;
+					}
+
+					++stats.freeBlockCount;
+					freeSize += block->size;
+					stats.largestFreeBlockSize = Max(stats.largestFreeBlockSize, block->size);
+				}
+		}
+
+		stats.usedSize = linear ? linearUsedSize : stats.reservedSize - freeSize - emptySize;
+		if (freeSize > 0)
+			stats.fragmentation = 1.f - static_cast<float>(stats.largestFreeBlockSize) / static_cast<float>(freeSize);
+		return stats;
+	}
+
+	void FreeArena::Stats::Print() const
+	{
+		std::cout << "[Free arena] pages: " << pageCount << " (" << emptyPageCount << " empty), allocations: " << allocationCount <<
+			", reserved: " << reservedSize << " B, used: " << usedSize << " B, free blocks: " << freeBlockCount <<
+			", largest free block: " << largestFreeBlockSize << " B, fragmentation: " << fragmentation << std::endl;
+	}
+
+#ifdef JV_FREE_ARENA_SELF_TEST
+	void FreeArena::SelfTest(Arena& tempArena, const App& app)
+	{
+		struct Allocation final
+		{
+			uint64_t handle;
+			Memory memory;
+			bool optimalTiling;
+		};
+
+		constexpr uint32_t ITERATION_COUNT = 50000;
+		// Small pages, so that allocations are spread over many of them.
+		constexpr VkDeviceSize PAGE_SIZE = 4 * 1024 * 1024;
+
+		const auto scope = tempArena.CreateScope();
+		auto allocations = CreateVector<Allocation>(tempArena, ITERATION_COUNT);
+		const auto freeArena = Create(tempArena, app, PAGE_SIZE);
+		const VkDeviceSize granularity = freeArena.bufferImageGranularity;
+
+		// Protected and lazily allocated memory can't be allocated without extra flags.
+		uint32_t memoryTypeBits = 0;
+		for (uint32_t i = 0; i < freeArena.pools.length; ++i)
+			if (!(freeArena.pools[i].memPropertyFlags & (VK_MEMORY_PROPERTY_PROTECTED_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT)))
+				memoryTypeBits |= 1u << i;
+
+		// Xorshift with a fixed seed, so that a failing run can be reproduced.
+		uint32_t seed = 1;
+		const auto random = [&seed]
+		{
+			seed ^= seed << 13;
+			seed ^= seed >> 17;
+			seed ^= seed << 5;
+			return seed;
+		};
+
+		const auto validate = [&allocations, granularity]
+		{
+			IntroSort(allocations.ptr, allocations.count, [](const Allocation& a, const Allocation& b)
+			{
+				if (a.memory.memory != b.memory.memory)
+					return a.memory.memory < b.memory.memory;
+				return a.memory.offset < b.memory.offset;
+			});
+
+			for (uint32_t i = 1; i < allocations.count; ++i)
+			{
+				const auto& prev = allocations[i - 1].memory;
+				const auto& cur = allocations[i].memory;
+				if (prev.memory != cur.memory)
+					continue;
+
+				assert(prev.offset + prev.size <= cur.offset);
+				if (allocations[i - 1].optimalTiling != allocations[i].optimalTiling)
+					assert((prev.offset + prev.size - 1) / granularity != cur.offset / granularity);
+				if (cur.mapped)
+					assert(static_cast<char*>(prev.mapped) - prev.offset == static_cast<char*>(cur.mapped) - cur.offset);
+			}
+		};
+
+		for (uint32_t i = 0; i < ITERATION_COUNT; ++i)
+		{
+			// Slightly favour allocating, so that pages fill up while blocks are being freed.
+			if (allocations.count == 0 || random() % 100 < 55)
+			{
+				VkMemoryRequirements memRequirements{};
+				memRequirements.alignment = static_cast<VkDeviceSize>(1) << random() % 12;
+				// Every now and then allocate something that needs a page of its own.
+				memRequirements.size = 1 + random() % (random() % 500 == 0 ? PAGE_SIZE * 2 : 16 * 1024);
+				memRequirements.memoryTypeBits = memoryTypeBits;
+				const VkMemoryPropertyFlags properties = random() % 2 ?
+					VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT : VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+
+				auto& allocation = allocations.Add();
+				allocation.optimalTiling = random() % 3 == 0;
+				allocation.handle = freeArena.Alloc(app, memRequirements, properties, 1, allocation.memory, allocation.optimalTiling);
+
+				const auto& memory = allocation.memory;
+				assert(memory.offset % memRequirements.alignment == 0);
+				assert(!allocation.optimalTiling || memory.offset % granularity == 0);
+				assert(memory.size >= memRequirements.size);
+				assert(!(properties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) || memory.mapped);
+			}
+			else
+			{
+				const uint32_t index = random() % allocations.count;
+				freeArena.Free(allocations[index].handle);
+				allocations.RemoveAt(index);
+			}
+
+			if (i % 1000 == 0)
+				validate();
+		}
+
+		validate();
+		for (const auto& allocation : allocations)
+			freeArena.Free(allocation.handle);
+
+		// Every page should have merged back into a single free block.
+		const auto stats = freeArena.GetStats();
+		stats.Print();
+		assert(stats.allocationCount == 0);
+		assert(stats.freeBlockCount == 0);
+		assert(stats.emptyPageCount == stats.pageCount);
+		assert(stats.usedSize == 0);
+
+		Destroy(tempArena, app, freeArena);
+		tempArena.DestroyScope(scope);
+		std::cout << "[Free arena] self test passed." << std::endl;
 	}
+#endif
 }
@@ -1,8 +1,10 @@
 ﻿#include "pch.h"
 #include "Vk/VkImage.h"
 
+#include "JLib/Math.h"
 #include "Vk/VkApp.h"
 #include "Vk/VkFreeArena.h"
+#include "Vk/VkStagingRing.h"
 
 namespace jv::vk
 {
@@ -69,109 +71,69 @@ namespace jv::vk
 		layout = newLayout;
 	}
 
-	void Image::FillImage(Arena& arena, const FreeArena& freeArena, const App& app, unsigned char* pixels, 
-		const VkCommandBuffer cmd, glm::ivec2* overrideResolution)
+	void Image::FillImage(StagingRing& stagingRing, const App& app, unsigned char* pixels, glm::ivec2* overrideResolution)
 	{
 		assert(usageFlags | VK_IMAGE_USAGE_TRANSFER_DST_BIT);
 
 		auto oResolution = overrideResolution ? *overrideResolution : resolution;
-		const uint32_t imageSize = oResolution.x * oResolution.y * 4;
-
-		VkBuffer stagingBuffer;
-		VkBufferCreateInfo bufferInfo{};
-		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-		bufferInfo.size = imageSize;
-		bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-		auto result = vkCreateBuffer(app.device, &bufferInfo, nullptr, &stagingBuffer);
-		assert(!result);
-
-		VkMemoryRequirements stagingMemRequirements;
-		vkGetBufferMemoryRequirements(app.device, stagingBuffer, &stagingMemRequirements);
-
-		Memory stagingMem{};
-		const auto stagingMemHandle = freeArena.Alloc(arena, app, stagingMemRequirements,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 1, stagingMem);
-		result = vkBindBufferMemory(app.device, stagingBuffer, stagingMem.memory, stagingMem.offset);
-		assert(!result);
-
-		// Copy pixels to staging buffer.
-		void* data;
-		vkMapMemory(app.device, stagingMem.memory, stagingMem.offset, imageSize, 0, &data);
-		memcpy(data, pixels, imageSize);
-		vkUnmapMemory(app.device, stagingMem.memory);
-		
-		vkResetCommandBuffer(cmd, VK_COMMAND_BUFFER_RESET_RELEASE_RESOURCES_BIT);
-
-		VkFence fence;
-		VkFenceCreateInfo fenceInfo{};
-		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-		fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-
-		result = vkCreateFence(app.device, &fenceInfo, nullptr, &fence);
-		assert(!result);
-		result = vkResetFences(app.device, 1, &fence);
-		assert(!result);
-
-		VkCommandBufferBeginInfo cmdBeginInfo{};
-		cmdBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-		cmdBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-		vkBeginCommandBuffer(cmd, &cmdBeginInfo);
-
-		auto currentLayout = layout;
-		TransitionLayout(cmd, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, aspectFlags);
+		const size_t rowSize = static_cast<size_t>(oResolution.x) * 4;
 
-		VkBufferImageCopy region{};
-		region.bufferOffset = 0;
-		region.bufferRowLength = 0;
-		region.bufferImageHeight = 0;
+		// Images that don't fit in the staging ring at once are copied a number of rows at a time.
+		const auto rowsPerStage = static_cast<uint32_t>(Min<VkDeviceSize>(stagingRing.GetMaxStageSize() / rowSize, UINT32_MAX));
+		if (rowsPerStage == 0)
+			throw std::exception("Image row doesn't fit in the staging ring.");
 
-		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		region.imageSubresource.mipLevel = 0;
-		region.imageSubresource.baseArrayLayer = 0;
-		region.imageSubresource.layerCount = 1;
-
-		region.imageOffset = { 0, 0, 0 };
-		region.imageExtent =
+		const auto currentLayout = layout;
+		uint32_t row = 0;
+		do
 		{
-			static_cast<uint32_t>(oResolution.x),
-			static_cast<uint32_t>(oResolution.y),
-			1
-		};
-
-		vkCmdCopyBufferToImage(
-			cmd,
-			stagingBuffer,
-			image,
-			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-			1,
-			&region
-		);
-
-		TransitionLayout(cmd, currentLayout, aspectFlags);
-
-		// End recording.
-		result = vkEndCommandBuffer(cmd);
-		assert(!result);
-
-		VkSubmitInfo cmdSubmitInfo{};
-		cmdSubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-		cmdSubmitInfo.commandBufferCount = 1;
-		cmdSubmitInfo.pCommandBuffers = &cmd;
-		cmdSubmitInfo.waitSemaphoreCount = 0;
-		cmdSubmitInfo.pWaitSemaphores = nullptr;
-		cmdSubmitInfo.signalSemaphoreCount = 0;
-		cmdSubmitInfo.pSignalSemaphores = nullptr;
-		cmdSubmitInfo.pWaitDstStageMask = nullptr;
-		result = vkQueueSubmit(app.queues[App::Queue::renderQueue], 1, &cmdSubmitInfo, fence);
-		assert(!result);
-
-		result = vkWaitForFences(app.device, 1, &fence, VK_TRUE, UINT64_MAX);
-		assert(!result);
-
-		vkDestroyFence(app.device, fence, nullptr);
-		vkDestroyBuffer(app.device, stagingBuffer, nullptr);
-		freeArena.Free(stagingMemHandle);
+			const uint32_t rowCount = Min<uint32_t>(rowsPerStage, oResolution.y - row);
+			VkDeviceSize stagingOffset;
+			const auto cmd = stagingRing.Stage(app, &pixels[row * rowSize], rowCount * rowSize, stagingOffset);
+
+			if (row == 0)
+			{
+				// The transfer queue can't wait for the stages that used the image before, so its old contents are discarded.
+				// Callers make sure that the image is no longer used by frames in flight.
+				if (stagingRing.transferOwnership)
+					layout = VK_IMAGE_LAYOUT_UNDEFINED;
+				TransitionLayout(cmd, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, aspectFlags);
+			}
+
+			VkBufferImageCopy region{};
+			region.bufferOffset = stagingOffset;
+			region.bufferRowLength = 0;
+			region.bufferImageHeight = 0;
+
+			region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			region.imageSubresource.mipLevel = 0;
+			region.imageSubresource.baseArrayLayer = 0;
+			region.imageSubresource.layerCount = 1;
+
+			region.imageOffset = { 0, static_cast<int32_t>(row), 0 };
+			region.imageExtent =
+			{
+				static_cast<uint32_t>(oResolution.x),
+				rowCount,
+				1
+			};
+
+			vkCmdCopyBufferToImage(
+				cmd,
+				stagingRing.buffer,
+				image,
+				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				1,
+				&region
+			);
+			row += rowCount;
+		} while (row < static_cast<uint32_t>(oResolution.y));
+
+		VkAccessFlags dstAccessMask;
+		VkPipelineStageFlags dstStageMask;
+		GetLayoutMasks(currentLayout, dstAccessMask, dstStageMask);
+		stagingRing.ReleaseImage(image, aspectFlags, currentLayout, dstAccessMask, dstStageMask);
+		layout = currentLayout;
 	}
 
 	Image Image::Create(Arena& arena, const FreeArena& freeArena, const App& app, 
@@ -205,8 +167,8 @@ namespace jv::vk
 		VkMemoryRequirements memRequirements;
 		vkGetImageMemoryRequirements(app.device, image.image, &memRequirements);
 
-		image.memoryHandle = freeArena.Alloc(arena, app, memRequirements,
-			0, 1, image.memory);
+		image.memoryHandle = freeArena.Alloc(app, memRequirements,
+			0, 1, image.memory, true);
 		result = vkBindImageMemory(app.device, image.image, image.memory.memory, image.memory.offset);
 		assert(!result);
 
@@ -2,8 +2,8 @@
 #include "Vk/VkInit.h"
 
 #include "JLib/ArrayUtils.h"
+#include "JLib/HashMapUtils.h"
 #include "JLib/HeapUtils.h"
-#include "JLib/MapUtils.h"
 #include "JLib/VectorUtils.h"
 #include <stdlib.h>
 #include <Windows.h>
@@ -36,7 +36,7 @@ namespace jv::vk::init
 
 	QueueFamilies::operator bool() const
 	{
-		return graphics != SIZE_MAX && present != SIZE_MAX && transfer != SIZE_MAX;
+		return graphics != UINT32_MAX && present != UINT32_MAX && transfer != UINT32_MAX;
 	}
 
 	bool IsPhysicalDeviceValid(const PhysicalDeviceInfo& info)
@@ -110,7 +110,7 @@ namespace jv::vk::init
 		appInfo.applicationVersion = version;
 		appInfo.pEngineName = "Vulkan Application";
 		appInfo.engineVersion = version;
-		appInfo.apiVersion = VK_API_VERSION_1_0;
+		appInfo.apiVersion = VK_API_VERSION_1_1;
 		return appInfo;
 	}
 
@@ -214,23 +214,26 @@ namespace jv::vk::init
 		uint32_t i = 0;
 		for (const auto& queueFamily : queueFamilies)
 		{
-			if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)
+			if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT && families.graphics == UINT32_MAX)
 				families.graphics = i;
 
-			if (queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT)
+			// Prefer a dedicated transfer family, so that uploads can run alongside rendering.
+			if (queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT && !(queueFamily.queueFlags & 
+				(VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)) && families.transfer == UINT32_MAX)
 				families.transfer = i;
 
 			VkBool32 presentSupport = false;
 			vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevice, i, surface, &presentSupport);
 
-			if (presentSupport)
+			if (presentSupport && (families.present == UINT32_MAX || i == families.graphics))
 				families.present = i;
-
-			if (families)
-				break;
 			++i;
 		}
 
+		// Graphics queues can always be used for transfer operations.
+		if (families.transfer == UINT32_MAX)
+			families.transfer = families.graphics;
+
 		arena.DestroyScope(scope);
 		return families;
 	}
@@ -361,7 +364,7 @@ namespace jv::vk::init
 
 		constexpr uint32_t queueFamiliesCount = sizeof(uint32_t) * 3;
 		auto queueCreateInfos = CreateVector<VkDeviceQueueCreateInfo>(arena, queueFamiliesCount);
-		auto familyIndexes = CreateMap<uint32_t>(arena, queueFamiliesCount);
+		auto familyIndexes = CreateHashMap<uint32_t, uint32_t>(arena, queueFamiliesCount);
 
 		const uint32_t queueFamiliesIndexes[3]
 		{
@@ -495,6 +498,30 @@ namespace jv::vk::init
 		app.debugger = CreateDebugger(app.instance);
 		app.surface = updatedInfo.createSurface(app.instance, info.userPtr);
 		app.physicalDevice = SelectPhysicalDevice(updatedInfo, app.instance, app.surface);
+
+		// Enable the memory budget extension when the device supports it.
+		const char* memoryBudgetExtension = VK_EXT_MEMORY_BUDGET_EXTENSION_NAME;
+		Array<const char*> optionalExtensions{};
+		optionalExtensions.ptr = &memoryBudgetExtension;
+		optionalExtensions.length = 1;
+		app.memoryBudget = CheckDeviceExtensionSupport(*updatedInfo.tempArena, app.physicalDevice, optionalExtensions);
+
+		bool memoryBudgetExtensionPresent = false;
+		for (const auto& deviceExtension : deviceExtensions)
+			if (strcmp(deviceExtension, memoryBudgetExtension) == 0)
+			{
+				memoryBudgetExtensionPresent = true;
+				break;
+			}
+
+		if (app.memoryBudget && !memoryBudgetExtensionPresent)
+		{
+			const auto extendedExtensions = CreateArray<const char*>(*info.tempArena, deviceExtensions.length + 1);
+			memcpy(extendedExtensions.ptr, deviceExtensions.ptr, sizeof(const char*) * deviceExtensions.length);
+			extendedExtensions[deviceExtensions.length] = memoryBudgetExtension;
+			updatedInfo.deviceExtensions = extendedExtensions;
+		}
+
 		CreateLogicalDevice(app, updatedInfo, *updatedInfo.tempArena, app.physicalDevice, app.surface, validationSupport);
 		app.commandPool = CreateCommandPool(*updatedInfo.tempArena, app.physicalDevice, app.surface, app.device);
 		
@@ -0,0 +1,349 @@
+﻿#include "pch.h"
+#include "Vk/VkStagingRing.h"
+#include "JLib/ArrayUtils.h"
+#include "Vk/VkApp.h"
+#include "Vk/VkInit.h"
+
+namespace jv::vk
+{
+	// Satisfies the buffer copy offset requirements of every format that is uploaded.
+	constexpr VkDeviceSize STAGING_ALIGNMENT = 16;
+
+	// Reclaims the space of all submissions that have finished, without waiting.
+	void ReclaimFinished(const App& app, StagingRing& ring)
+	{
+		while (true)
+		{
+			auto& submission = ring.submissions[ring.oldest];
+			if (!submission.pending || vkGetFenceStatus(app.device, submission.fence) != VK_SUCCESS)
+				return;
+			submission.pending = false;
+			ring.tail = submission.end;
+			ring.oldest = (ring.oldest + 1) % ring.submissions.length;
+		}
+	}
+
+	// Waits for the oldest submission to finish and reclaims its space. Returns false if nothing has been submitted.
+	bool ReclaimOldest(const App& app, StagingRing& ring)
+	{
+		auto& submission = ring.submissions[ring.oldest];
+		if (!submission.pending)
+			return false;
+
+		const auto result = vkWaitForFences(app.device, 1, &submission.fence, VK_TRUE, UINT64_MAX);
+		assert(!result);
+		submission.pending = false;
+		ring.tail = submission.end;
+		ring.oldest = (ring.oldest + 1) % ring.submissions.length;
+		return true;
+	}
+
+	VkCommandBuffer StagingRing::Stage(const App& app, const void* data, const VkDeviceSize dataSize, VkDeviceSize& outOffset)
+	{
+		if (dataSize > GetMaxStageSize())
+			throw std::exception("Upload doesn't fit in the staging ring.");
+		ReclaimFinished(app, *this);
+
+		uint64_t offset;
+		while (true)
+		{
+			offset = (head + STAGING_ALIGNMENT - 1) & ~(STAGING_ALIGNMENT - 1);
+			// Uploads can't wrap around, so skip the end of the ring if it doesn't fit.
+			if (offset % size + dataSize > size)
+				offset += size - offset % size;
+			if (offset + dataSize - tail <= size)
+				break;
+
+			if (ReclaimOldest(app, *this))
+				continue;
+			// The rest of the ring is used by uploads that haven't been submitted yet.
+			if (recording)
+			{
+				Flush(app);
+				continue;
+			}
+			// The ring is empty, so start over at the beginning.
+			head = tail = offset - offset % size;
+		}
+
+		auto& submission = submissions[current];
+		if (!recording)
+		{
+			// Every submission is in flight, so wait for the one that is about to be reused.
+			if (submission.pending)
+				ReclaimOldest(app, *this);
+
+			auto result = vkResetFences(app.device, 1, &submission.fence);
+			assert(!result);
+			vkResetCommandBuffer(submission.cmd, 0);
+
+			VkCommandBufferBeginInfo cmdBeginInfo{};
+			cmdBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+			cmdBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+			result = vkBeginCommandBuffer(submission.cmd, &cmdBeginInfo);
+			assert(!result);
+
+			if (transferOwnership)
+			{
+				vkResetCommandBuffer(submission.acquireCmd, 0);
+				result = vkBeginCommandBuffer(submission.acquireCmd, &cmdBeginInfo);
+				assert(!result);
+			}
+
+			acquireStageMask = 0;
+			recording = true;
+		}
+
+		memcpy(static_cast<char*>(mapped) + offset % size, data, dataSize);
+		head = offset + dataSize;
+		outOffset = offset % size;
+		return submission.cmd;
+	}
+
+	VkDeviceSize StagingRing::GetMaxStageSize() const
+	{
+		return size / 2 & ~(STAGING_ALIGNMENT - 1);
+	}
+
+	void StagingRing::ReleaseBuffer(const VkBuffer buffer, const VkAccessFlags dstAccessMask, const VkPipelineStageFlags dstStageMask)
+	{
+		assert(recording);
+		auto& submission = submissions[current];
+
+		VkBufferMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = dstAccessMask;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.buffer = buffer;
+		barrier.offset = 0;
+		barrier.size = VK_WHOLE_SIZE;
+
+		if (!transferOwnership)
+		{
+			vkCmdPipelineBarrier(submission.cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, dstStageMask,
+				0, 0, nullptr, 1, &barrier, 0, nullptr);
+			return;
+		}
+
+		// Release on the transfer queue, the access masks that don't belong to the queue are ignored.
+		barrier.srcQueueFamilyIndex = transferQueueFamily;
+		barrier.dstQueueFamilyIndex = renderQueueFamily;
+		barrier.dstAccessMask = 0;
+		vkCmdPipelineBarrier(submission.cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+			0, 0, nullptr, 1, &barrier, 0, nullptr);
+
+		// Acquire on the render queue, after waiting for the copies in the stages that use the buffer.
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = dstAccessMask;
+		vkCmdPipelineBarrier(submission.acquireCmd, dstStageMask, dstStageMask,
+			0, 0, nullptr, 1, &barrier, 0, nullptr);
+		acquireStageMask |= dstStageMask;
+	}
+
+	void StagingRing::ReleaseImage(const VkImage image, const VkImageAspectFlags aspectFlags, const VkImageLayout newLayout,
+		const VkAccessFlags dstAccessMask, const VkPipelineStageFlags dstStageMask)
+	{
+		assert(recording);
+		auto& submission = submissions[current];
+
+		VkImageMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = dstAccessMask;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.newLayout = newLayout;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = image;
+		barrier.subresourceRange.aspectMask = aspectFlags;
+		barrier.subresourceRange.baseMipLevel = 0;
+		barrier.subresourceRange.levelCount = 1;
+		barrier.subresourceRange.baseArrayLayer = 0;
+		barrier.subresourceRange.layerCount = 1;
+
+		if (!transferOwnership)
+		{
+			vkCmdPipelineBarrier(submission.cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, dstStageMask,
+				0, 0, nullptr, 0, nullptr, 1, &barrier);
+			return;
+		}
+
+		// Both halves of the ownership transfer describe the same layout transition, it's only executed once.
+		barrier.srcQueueFamilyIndex = transferQueueFamily;
+		barrier.dstQueueFamilyIndex = renderQueueFamily;
+		barrier.dstAccessMask = 0;
+		vkCmdPipelineBarrier(submission.cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+			0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = dstAccessMask;
+		vkCmdPipelineBarrier(submission.acquireCmd, dstStageMask, dstStageMask,
+			0, 0, nullptr, 0, nullptr, 1, &barrier);
+		acquireStageMask |= dstStageMask;
+	}
+
+	void StagingRing::Flush(const App& app)
+	{
+		if (!recording)
+			return;
+
+		auto& submission = submissions[current];
+
+		auto result = vkEndCommandBuffer(submission.cmd);
+		assert(!result);
+
+		VkSubmitInfo submitInfo{};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &submission.cmd;
+
+		if (!transferOwnership)
+		{
+			result = vkQueueSubmit(app.queues[App::renderQueue], 1, &submitInfo, submission.fence);
+			assert(!result);
+		}
+		else
+		{
+			submitInfo.signalSemaphoreCount = 1;
+			submitInfo.pSignalSemaphores = &submission.semaphore;
+			result = vkQueueSubmit(app.queues[App::transferQueue], 1, &submitInfo, nullptr);
+			assert(!result);
+
+			result = vkEndCommandBuffer(submission.acquireCmd);
+			assert(!result);
+
+			// Work submitted to the render queue after this point only starts using the uploads once the copies are done.
+			const VkPipelineStageFlags waitStageMask = acquireStageMask ? acquireStageMask : VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+			VkSubmitInfo acquireSubmitInfo{};
+			acquireSubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+			acquireSubmitInfo.waitSemaphoreCount = 1;
+			acquireSubmitInfo.pWaitSemaphores = &submission.semaphore;
+			acquireSubmitInfo.pWaitDstStageMask = &waitStageMask;
+			acquireSubmitInfo.commandBufferCount = 1;
+			acquireSubmitInfo.pCommandBuffers = &submission.acquireCmd;
+			result = vkQueueSubmit(app.queues[App::renderQueue], 1, &acquireSubmitInfo, submission.fence);
+			assert(!result);
+		}
+
+		submission.end = head;
+		submission.pending = true;
+		current = (current + 1) % submissions.length;
+		recording = false;
+	}
+
+	void StagingRing::Wait(const App& app)
+	{
+		Flush(app);
+		while (ReclaimOldest(app, *this));
+	}
+
+	StagingRing StagingRing::Create(Arena& arena, Arena& tempArena, const App& app, const VkDeviceSize size, const uint32_t submissionCount)
+	{
+		assert(submissionCount > 0);
+
+		StagingRing ring{};
+		ring.size = size;
+
+		const auto families = init::GetQueueFamilies(tempArena, app.physicalDevice, app.surface);
+		ring.transferQueueFamily = families.transfer;
+		ring.renderQueueFamily = families.graphics;
+		ring.transferOwnership = families.transfer != families.graphics;
+
+		VkCommandPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolInfo.queueFamilyIndex = ring.transferOwnership ? ring.transferQueueFamily : ring.renderQueueFamily;
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+		auto result = vkCreateCommandPool(app.device, &poolInfo, nullptr, &ring.commandPool);
+		assert(!result);
+
+		VkBufferCreateInfo bufferInfo{};
+		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferInfo.size = size;
+		bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		result = vkCreateBuffer(app.device, &bufferInfo, nullptr, &ring.buffer);
+		assert(!result);
+
+		VkMemoryRequirements memRequirements;
+		vkGetBufferMemoryRequirements(app.device, ring.buffer, &memRequirements);
+
+		VkPhysicalDeviceMemoryProperties memProperties;
+		vkGetPhysicalDeviceMemoryProperties(app.physicalDevice, &memProperties);
+		constexpr VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+		uint32_t typeIndex = UINT32_MAX;
+		for (uint32_t i = 0; i < memProperties.memoryTypeCount; ++i)
+			if (memRequirements.memoryTypeBits & 1 << i && (memProperties.memoryTypes[i].propertyFlags & properties) == properties)
+			{
+				typeIndex = i;
+				break;
+			}
+		assert(typeIndex != UINT32_MAX);
+
+		VkMemoryAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		allocInfo.allocationSize = memRequirements.size;
+		allocInfo.memoryTypeIndex = typeIndex;
+		result = vkAllocateMemory(app.device, &allocInfo, nullptr, &ring.memory);
+		assert(!result);
+		result = vkBindBufferMemory(app.device, ring.buffer, ring.memory, 0);
+		assert(!result);
+		result = vkMapMemory(app.device, ring.memory, 0, VK_WHOLE_SIZE, 0, &ring.mapped);
+		assert(!result);
+
+		ring.submissions = CreateArray<Submission>(arena, submissionCount);
+		for (auto& submission : ring.submissions)
+		{
+			submission = {};
+
+			VkCommandBufferAllocateInfo cmdBufferAllocInfo{};
+			cmdBufferAllocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			cmdBufferAllocInfo.commandPool = ring.commandPool;
+			cmdBufferAllocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+			cmdBufferAllocInfo.commandBufferCount = 1;
+			result = vkAllocateCommandBuffers(app.device, &cmdBufferAllocInfo, &submission.cmd);
+			assert(!result);
+
+			if (ring.transferOwnership)
+			{
+				cmdBufferAllocInfo.commandPool = app.commandPool;
+				result = vkAllocateCommandBuffers(app.device, &cmdBufferAllocInfo, &submission.acquireCmd);
+				assert(!result);
+
+				VkSemaphoreCreateInfo semaphoreInfo{};
+				semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+				result = vkCreateSemaphore(app.device, &semaphoreInfo, nullptr, &submission.semaphore);
+				assert(!result);
+			}
+
+			VkFenceCreateInfo fenceInfo{};
+			fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+			result = vkCreateFence(app.device, &fenceInfo, nullptr, &submission.fence);
+			assert(!result);
+		}
+
+		return ring;
+	}
+
+	void StagingRing::Destroy(Arena& arena, const App& app, const StagingRing& stagingRing)
+	{
+		for (const auto& submission : stagingRing.submissions)
+		{
+			assert(!submission.pending);
+			vkDestroyFence(app.device, submission.fence, nullptr);
+			if (stagingRing.transferOwnership)
+			{
+				vkDestroySemaphore(app.device, submission.semaphore, nullptr);
+				vkFreeCommandBuffers(app.device, app.commandPool, 1, &submission.acquireCmd);
+			}
+		}
+		DestroyArray(arena, stagingRing.submissions);
+		vkDestroyCommandPool(app.device, stagingRing.commandPool, nullptr);
+
+		vkUnmapMemory(app.device, stagingRing.memory);
+		vkDestroyBuffer(app.device, stagingRing.buffer, nullptr);
+		vkFreeMemory(app.device, stagingRing.memory, nullptr);
+	}
+}
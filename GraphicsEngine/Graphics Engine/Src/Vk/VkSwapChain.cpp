@@ -253,7 +253,7 @@ namespace jv::vk
 		image.fence = frame.inFlightFence;
 	}
 
-	VkCommandBuffer SwapChain::BeginFrame(const App& app, const bool manuallyCallWaitForImage)
+	VkCommandBuffer SwapChain::BeginFrame(const App& app, const bool manuallyCallWaitForImage, const VkSubpassContents contents)
 	{
 		if (!manuallyCallWaitForImage)
 			WaitForImage(app);
@@ -277,7 +277,7 @@ namespace jv::vk
 		renderPassBeginInfo.clearValueCount = 1;
 		renderPassBeginInfo.pClearValues = &clearColor;
 
-		vkCmdBeginRenderPass(image.cmdBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+		vkCmdBeginRenderPass(image.cmdBuffer, &renderPassBeginInfo, contents);
 		return image.cmdBuffer;
 	}
 
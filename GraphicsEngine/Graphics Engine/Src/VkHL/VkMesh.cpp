@@ -4,142 +4,88 @@
 #include "JLib/Math.h"
 #include "Vk/VkApp.h"
 #include "Vk/VkFreeArena.h"
+#include "Vk/VkStagingRing.h"
 
 namespace jv::vk
 {
-	Buffer CreateVertexBuffer(Arena& arena, const FreeArena& freeArena, const App& app,
-		void* data, uint32_t size, const VkBufferUsageFlags usageFlags)
+	constexpr uint32_t MAX_VERTEX_BUFFER_COUNT = 8;
+
+	Buffer CreateVertexBuffer(const FreeArena& freeArena, const App& app, StagingRing& stagingRing,
+		void* data, const uint32_t dataSize, const VkBufferUsageFlags usageFlags)
 	{
 		VkPhysicalDeviceProperties properties{};
 		vkGetPhysicalDeviceProperties(app.physicalDevice, &properties);
 		const auto minSize = static_cast<uint32_t>(properties.limits.minUniformBufferOffsetAlignment);
-		size = Max<uint32_t>(size, minSize);
+		const uint32_t size = Max<uint32_t>(dataSize, minSize);
 
 		VkBufferCreateInfo bufferInfo{};
 		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
 		bufferInfo.size = size;
-		bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-		VkBuffer stagingBuffer;
-		auto result = vkCreateBuffer(app.device, &bufferInfo, nullptr, &stagingBuffer);
-		assert(!result);
-
-		VkMemoryRequirements stagingMemRequirements;
-		vkGetBufferMemoryRequirements(app.device, stagingBuffer, &stagingMemRequirements);
-
-		Memory stagingMem;
-		const auto stagingMemHandle = freeArena.Alloc(arena, app, stagingMemRequirements, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 1, stagingMem);
-		result = vkBindBufferMemory(app.device, stagingBuffer, stagingMem.memory, stagingMem.offset);
-		assert(!result);
-
-		// Move vertex/index data to a staging buffer. 
-		void* stagingData;
-		vkMapMemory(app.device, stagingMem.memory, stagingMem.offset, stagingMem.size, 0, &stagingData);
-		memcpy(stagingData, data, bufferInfo.size);
-		vkUnmapMemory(app.device, stagingMem.memory);
-
 		bufferInfo.usage = usageFlags | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
 		VkBuffer buffer;
-		result = vkCreateBuffer(app.device, &bufferInfo, nullptr, &buffer);
+		auto result = vkCreateBuffer(app.device, &bufferInfo, nullptr, &buffer);
 		assert(!result);
 
 		VkMemoryRequirements memRequirements;
 		vkGetBufferMemoryRequirements(app.device, buffer, &memRequirements);
 
 		Memory mem;
-		const auto memHandle = freeArena.Alloc(arena, app, memRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 1, mem);
+		const auto memHandle = freeArena.Alloc(app, memRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 1, mem);
 		result = vkBindBufferMemory(app.device, buffer, mem.memory, mem.offset);
 		assert(!result);
 
-		// Record and execute copy. 
-		VkCommandBuffer cmdBuffer;
-		VkCommandBufferAllocateInfo cmdBufferAllocInfo{};
-		cmdBufferAllocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-		cmdBufferAllocInfo.commandPool = app.commandPool;
-		cmdBufferAllocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-		cmdBufferAllocInfo.commandBufferCount = 1;
-
-		result = vkAllocateCommandBuffers(app.device, &cmdBufferAllocInfo, &cmdBuffer);
-		assert(!result);
-
-		VkFence fence;
-		VkFenceCreateInfo fenceInfo{};
-		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-		fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-
-		result = vkCreateFence(app.device, &fenceInfo, nullptr, &fence);
-		assert(!result);
-		result = vkResetFences(app.device, 1, &fence);
-		assert(!result);
-
-		VkCommandBufferBeginInfo cmdBeginInfo{};
-		cmdBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-		cmdBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-		vkBeginCommandBuffer(cmdBuffer, &cmdBeginInfo);
-
-		VkBufferCopy region{};
-		region.srcOffset = 0;
-		region.dstOffset = 0;
-		region.size = size;
-		vkCmdCopyBuffer(cmdBuffer, stagingBuffer, buffer, 1, &region);
-
-		result = vkEndCommandBuffer(cmdBuffer);
-		assert(!result);
-
-		VkSubmitInfo cmdSubmitInfo{};
-		cmdSubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-		cmdSubmitInfo.commandBufferCount = 1;
-		cmdSubmitInfo.pCommandBuffers = &cmdBuffer;
-		cmdSubmitInfo.waitSemaphoreCount = 0;
-		cmdSubmitInfo.pWaitSemaphores = nullptr;
-		cmdSubmitInfo.signalSemaphoreCount = 0;
-		cmdSubmitInfo.pSignalSemaphores = nullptr;
-		cmdSubmitInfo.pWaitDstStageMask = nullptr;
-		result = vkQueueSubmit(app.queues[App::Queue::renderQueue], 1, &cmdSubmitInfo, fence);
-		assert(!result);
-
-		result = vkWaitForFences(app.device, 1, &fence, VK_TRUE, UINT64_MAX);
-		assert(!result);
-
-		vkDestroyFence(app.device, fence, nullptr);
-		vkDestroyBuffer(app.device, stagingBuffer, nullptr);
-		freeArena.Free(stagingMemHandle);
+		// Move vertex/index data to the staging ring and record the copy, it's submitted with the next flush.
+		// Data that doesn't fit in the ring at once is copied in parts.
+		const VkDeviceSize maxStageSize = stagingRing.GetMaxStageSize();
+		VkDeviceSize copied = 0;
+		do
+		{
+			VkBufferCopy region{};
+			region.dstOffset = copied;
+			region.size = Min<VkDeviceSize>(dataSize - copied, maxStageSize);
+			const auto cmd = stagingRing.Stage(app, static_cast<char*>(data) + copied, region.size, region.srcOffset);
+			vkCmdCopyBuffer(cmd, stagingRing.buffer, buffer, 1, &region);
+			copied += region.size;
+		} while (copied < dataSize);
+		stagingRing.ReleaseBuffer(buffer, usageFlags & VK_BUFFER_USAGE_INDEX_BUFFER_BIT ? 
+			VK_ACCESS_INDEX_READ_BIT : VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
 
 		Buffer ret{};
 		ret.buffer = buffer;
 		ret.memory = mem;
+		ret.memoryHandle = memHandle;
 		return ret;
 	}
 
-	void Mesh::Draw(Arena& tempArena, const VkCommandBuffer cmd, const uint32_t count) const
+	void Mesh::Draw(const VkCommandBuffer cmd, const uint32_t count) const
 	{
-		const auto scope = tempArena.CreateScope();
+		assert(vertexBuffers.length <= MAX_VERTEX_BUFFER_COUNT);
 
-		const auto buffers = CreateArray<VkBuffer>(tempArena, vertexBuffers.length);
+		VkBuffer buffers[MAX_VERTEX_BUFFER_COUNT];
+		VkDeviceSize offsets[MAX_VERTEX_BUFFER_COUNT]{};
 		for (uint32_t i = 0; i < vertexBuffers.length; ++i)
 			buffers[i] = vertexBuffers[i].buffer;
 
-		constexpr VkDeviceSize offset = 0;
-		vkCmdBindVertexBuffers(cmd, 0, vertexBuffers.length, buffers.ptr, &offset);
+		vkCmdBindVertexBuffers(cmd, 0, vertexBuffers.length, buffers, offsets);
 		vkCmdBindIndexBuffer(cmd, indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT16);
 		vkCmdDrawIndexed(cmd, indexCount, count, 0, 0, 0);
-
-		tempArena.DestroyScope(scope);
 	}
 
-	Mesh Mesh::Create(Arena& arena, const FreeArena& freeArena, const App& app, 
+	Mesh Mesh::Create(Arena& arena, const FreeArena& freeArena, const App& app, StagingRing& stagingRing,
 		void** attributes, const uint32_t* attributeSizes, const uint32_t attributeCount,
 		const Array<VertexIndex>& indices)
 	{
+		assert(attributeCount <= MAX_VERTEX_BUFFER_COUNT);
+
 		Mesh mesh{};
-		mesh.indexBuffer = CreateVertexBuffer(arena, freeArena, app, indices.ptr, indices.length * sizeof(VertexIndex), VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+		mesh.indexBuffer = CreateVertexBuffer(freeArena, app, stagingRing, indices.ptr, indices.length * sizeof(VertexIndex), VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
 		mesh.indexCount = indices.length;
 
 		mesh.vertexBuffers = CreateArray<Buffer>(arena, attributeCount);
 		for (uint32_t i = 0; i < attributeCount; ++i)
-			mesh.vertexBuffers[i] = CreateVertexBuffer(arena, freeArena, app, attributes[i], attributeSizes[i], VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+			mesh.vertexBuffers[i] = CreateVertexBuffer(freeArena, app, stagingRing, attributes[i], attributeSizes[i], VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
 		return mesh;
 	}
 
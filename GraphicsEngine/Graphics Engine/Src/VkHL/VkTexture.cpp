@@ -84,7 +84,7 @@ namespace jv::vk
 		outfile.close();
 	}
 
-	Image LoadTexture(Arena& arena, const FreeArena& freeArena, const App& app, const ImageCreateInfo& info, const char* imageFilePath)
+	Image LoadTexture(Arena& arena, const FreeArena& freeArena, const App& app, StagingRing& stagingRing, const ImageCreateInfo& info, const char* imageFilePath)
 	{
 		// Load pixels.
 		int texWidth, texHeight, texChannels;
@@ -95,7 +95,7 @@ namespace jv::vk
 		auto cpyInfo = info;
 		cpyInfo.resolution = glm::ivec3(texWidth, texHeight, texChannels);
 		auto image = Image::Create(arena, freeArena, app, cpyInfo);
-		image.FillImage(arena, freeArena, app, pixels, info.cmd);
+		image.FillImage(stagingRing, app, pixels);
 
 		// Free pixels.
 		stbi_image_free(pixels);
@@ -103,7 +103,7 @@ namespace jv::vk
 		return image;
 	}
 
-	void FillTexture(Arena& arena, const FreeArena& freeArena, const App& app, Image& image, const char* imageFilePath, const VkCommandBuffer cmd)
+	void FillTexture(StagingRing& stagingRing, const App& app, Image& image, const char* imageFilePath)
 	{
 		// Load pixels.
 		int texWidth, texHeight, texChannels;
@@ -111,7 +111,7 @@ namespace jv::vk
 		assert(pixels);
 
 		assert(image.usageFlags | VK_IMAGE_USAGE_TRANSFER_DST_BIT);
-		image.FillImage(arena, freeArena, app, pixels, cmd);
+		image.FillImage(stagingRing, app, pixels);
 
 		// Free pixels.
 		stbi_image_free(pixels);